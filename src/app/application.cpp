@@ -1,30 +1,28 @@
 #include "application.h"
-#include "../detail/random_gen.h"
- 
-#include <random>
-#include <sstream>
-#include <iomanip>
 
-namespace {
-    using namespace application;
+#include <exception>
 
-    Application::Token GenerateToken() {    
-        const std::uint64_t a = detail::GenerateRandomInt<std::uint64_t>();
-        const std::uint64_t b = detail::GenerateRandomInt<std::uint64_t>();        
-
-        std::ostringstream oss;
-        oss << std::hex << std::setw(16) << std::setfill('0') << a
-            << std::setw(16) << std::setfill('0') << b;
+namespace application {
 
-        return oss.str();
+    Player& Players::AddPlayer(const Player::Id id, const std::string& name, 
+                               model::GameSession& session, model::DogHandle dog) {
+        auto [it, inserted] = players_.emplace(id, Player{id, name, session, dog});
+        if (inserted) {
+            map_players_[it->second.GetMapId()].emplace(id, &it->second);
+        }
+        return it->second;
     }
-}
 
-namespace application {
+    void Players::RemovePlayer(Player::Id id) {
+        auto it = players_.find(id);
+        if (it == players_.end()) {
+            return;
+        }
 
-    Player& Players::AddPlayer(const Player::Id id,  const model::Dog* dog, const model::Map::Id& map_id) {
-        auto [it, inserted] = players_.emplace(id, Player{id, dog, map_id});
-        return it->second;
+        if (auto map_it = map_players_.find(it->second.GetMapId()); map_it != map_players_.end()) {
+            map_it->second.erase(id);
+        }
+        players_.erase(it);
     }
 
     const Player* Players::FindPlayerById(Player::Id id) const {
@@ -36,8 +34,7 @@ namespace application {
 
     const Player* Players::FindPlayerByDogName(const std::string& dog_name) const {
         for (const auto& [id, player] : players_) {
-            const auto* dog = player.GetDog();
-            if (dog != nullptr && dog->GetName() == dog_name) {
+            if (player.GetDog() != nullptr && player.GetName() == dog_name) {
                 return &player;
             }
         }
@@ -45,7 +42,30 @@ namespace application {
     }
 
     void PlayerTokens::SetTokenForPlayer(const Token& token, Player::Id id) {
-        tokens_[token] = id;
+        auto [it, inserted] = tokens_.try_emplace(token, id);
+        if (!inserted) {
+            if (it->second == id) {
+                return;
+            }
+            // the token moves to another player
+            auto [first, last] = player_tokens_.equal_range(it->second);
+            for (; first != last; ++first) {
+                if (first->second == token) {
+                    player_tokens_.erase(first);
+                    break;
+                }
+            }
+            it->second = id;
+        }
+        player_tokens_.emplace(id, token);
+    }
+
+    void PlayerTokens::RemoveTokensForPlayer(Player::Id id) {
+        auto [first, last] = player_tokens_.equal_range(id);
+        for (auto it = first; it != last; ++it) {
+            tokens_.erase(it->second);
+        }
+        player_tokens_.erase(first, last);
     }
 
     std::optional<Player::Id> PlayerTokens::FindPlayerByToken(const Token& token) const {
@@ -55,27 +75,51 @@ namespace application {
         return std::nullopt;
     }
 
+    Application::MapAccess Application::LockMapAccess() const {
+        return MapAccess{world_mutex_};
+    }
+
     Application::JoinResult Application::JoinGame(const std::string& dog_name, const std::string& map_id) {
         // 1. searching map in game_ by map_id
         const model::Map* map = game_.FindMap(model::Map::Id{map_id});
         model::GameSession& session = game_.GetSessionForMap(model::Map::Id{map_id});
 
-        // 2. creating dog in map with name: dog_name
-        model::Dog* dog = session.SpawnDog(dog_name, next_player_id_, map->GetDogsBagCapacity());
+        // 2. reserving player id, it is shared by all maps
+        Player::Id id;
+        {
+            std::unique_lock registry_lock{registry_mutex_};
+            id = next_player_id_++;
+        }
 
-        // 3. creating player
-        Player::Id id = next_player_id_++;
-        Player& player = players_.AddPlayer(id, dog, model::Map::Id{map_id});
+        // 3. creating dog in map with name: dog_name
+        const auto dog = session.SpawnDog(dog_name, id, map->GetDogsBagCapacity());
+        if (!dog) {
+            throw std::runtime_error("Joining failed: dog id is already taken");
+        }
 
-        // 4. generating token
-        Token token = GenerateToken();
-        tokens_.SetTokenForPlayer(token, id);
+        // 4. creating player and generating token
+        Token token = Token::Generate();
+        {
+            std::unique_lock registry_lock{registry_mutex_};
+            players_.AddPlayer(id, dog_name, session, *dog);
+            tokens_.SetTokenForPlayer(token, id);
+        }
 
         return JoinResult{token, id};
     }
 
-    std::optional<Player::Id> Application::FindPlayerIdByToken(const Token& token) const {
-        return tokens_.FindPlayerByToken(token);
+    std::optional<Application::TokenOwner> Application::FindTokenOwner(const Token& token) const {
+        std::shared_lock registry_lock{registry_mutex_};
+        const auto player_id = tokens_.FindPlayerByToken(token);
+        if (!player_id) {
+            return std::nullopt;
+        }
+
+        const Player* player = players_.FindPlayerById(*player_id);
+        if (player == nullptr) {
+            return std::nullopt;
+        }
+        return TokenOwner{*player_id, player->GetMapId()};
     }
 
     const std::deque<model::Map>& Application::GetAllMaps() const {
@@ -87,51 +131,58 @@ namespace application {
     }
 
     const Player* Application::FindPlayerById(Player::Id id) const {
+        std::shared_lock registry_lock{registry_mutex_};
         return players_.FindPlayerById(id);
     }
 
-    std::vector<Player> Application::GetPlayersInMap(const model::Map::Id& map_id) const {
-        return players_.GetPlayersInMap(map_id);
-    }
-
     std::vector<model::LootItem> Application::GetItemsInMap(const model::Map::Id& map_id) const {
         return game_.GetLootItemsInMap(map_id);
     }
 
+    uint64_t Application::GetMapStateVersion(const model::Map::Id& map_id) const {
+        return game_.GetSessionForMap(map_id).GetStateVersion();
+    }
+
+    std::optional<model::StateDelta> Application::GetMapChangesSince(const model::Map::Id& map_id, 
+                                                                     uint64_t version) const {
+        return game_.GetSessionForMap(map_id).GetChangesSince(version);
+    }
+
+    const model::GameSession& Application::GetMapSession(const model::Map::Id& map_id) const {
+        return game_.GetSessionForMap(map_id);
+    }
+
     void Application::MovePlayer(Player::Id player_id, const pos::Direction& dir) {
-        const Player* player = players_.FindPlayerById(player_id);
+        const Player* player = FindPlayerById(player_id);
         if (player == nullptr) {
             return;
         }
 
         auto& session = game_.GetSessionForMap(player->GetMapId());
 
-        // we need to change dog move-parameters, but Player holds const Dog*
-        {
-            model::Dog* dog = const_cast<model::Dog*>(player->GetDog());
-            if (dog == nullptr) {
-                return;
-            }
-            session.MoveDog(*dog, dir);
-        }        
+        model::Dog* dog = player->GetDog();
+        if (dog == nullptr) {
+            return;
+        }
+        session.MoveDog(*dog, dir);
     }
 
     void Application::StopPlayer(Player::Id player_id) {
-        const Player* player = players_.FindPlayerById(player_id);
+        const Player* player = FindPlayerById(player_id);
         if (player == nullptr) {
             return;
         }
 
-        model::Dog* dog = const_cast<model::Dog*>(player->GetDog());
+        model::Dog* dog = player->GetDog();
         if (dog == nullptr) {
             return;
         }
 
-        dog->SetVelocity(pos::Velocity{0.0, 0.0});
+        game_.GetSessionForMap(player->GetMapId()).StopDog(*dog);
     }
 
     void Application::RetirePlayer(Player::Id player_id) {
-        const Player* player = players_.FindPlayerById(player_id);
+        const Player* player = FindPlayerById(player_id);
         if (player == nullptr) {
             return;
         }
@@ -141,25 +192,32 @@ namespace application {
             return;
         }
 
-        const auto timing_it = player_timing_.find(player_id);
-        const double play_time = (timing_it != player_timing_.end()) ? timing_it->second.play_time_sec : 0.0;
+        auto& timings = player_timing_.at(player->GetMapId());
+        const auto timing_it = timings.find(player_id);
+        const double play_time = (timing_it != timings.end()) ? timing_it->second.play_time_sec : 0.0;
 
         PlayerRecord record;
-        record.name = dog->GetName();
+        record.name = player->GetName();
         record.score = dog->GetScore();
         record.play_time = play_time;
         SaveRetiredPlayerRecord(record);
 
         // remove from runtime state
-        tokens_.RemoveTokensForPlayer(player_id);
+        const model::Map::Id map_id = player->GetMapId();
+        const int dog_id = dog->GetId();
+        {
+            std::unique_lock registry_lock{registry_mutex_};
+            tokens_.RemoveTokensForPlayer(player_id);
+            players_.RemovePlayer(player_id);
+            token_generation_.fetch_add(1, std::memory_order_release);
+        }
 
-        auto& session = game_.GetSessionForMap(player->GetMapId());
-        session.RemoveDog(dog->GetId());
-        players_.RemovePlayer(player_id);
-        player_timing_.erase(player_id);
+        game_.GetSessionForMap(map_id).RemoveDog(dog_id);
+        timings.erase(player_id);
     }
 
     AppState Application::GetState() const {
+        std::unique_lock world_lock{world_mutex_};
         AppState app_state;
 
         // saving maps and sessions
@@ -170,10 +228,10 @@ namespace application {
             const auto& session = game_.GetSessionForMap(map.GetId());
 
             // saving dogs
-            for (const auto& [dog_id, dog] : session.GetAllDogs()) {
+            for (const auto& dog : session.GetAllDogs()) {
                 DogState dog_state;
                 dog_state.id = dog.GetId();
-                dog_state.name = dog.GetName();
+                dog_state.name = session.GetDogName(dog.GetId());
                 dog_state.x = dog.GetCoordinates().x;
                 dog_state.y = dog.GetCoordinates().y;
                 dog_state.vx = dog.GetVelocity().vx;
@@ -232,7 +290,8 @@ namespace application {
             player_link.map_id = static_cast<std::string>(*player.GetMapId());
             player_link.dog_id = player.GetDog()->GetId();
 
-            if (auto it = player_timing_.find(player_id); it != player_timing_.end()) {
+            const auto& timings = player_timing_.at(player.GetMapId());
+            if (auto it = timings.find(player_id); it != timings.end()) {
                 player_link.play_time_sec = it->second.play_time_sec;
                 player_link.idle_time_sec = it->second.idle_time_sec;
             }
@@ -243,7 +302,7 @@ namespace application {
         // saving tokens
         for (const auto& [token, player_id] : tokens_.GetAllTokens()) {
             AuthState::TokenLink token_link;
-            token_link.token = token;
+            token_link.token = token.ToHex();
             token_link.player_id = player_id;
 
             app_state.auth.tokens.push_back(token_link);
@@ -253,6 +312,8 @@ namespace application {
     }
 
     void Application::RestoreState(const AppState& app_state) {
+        std::unique_lock world_lock{world_mutex_};
+
         // restoring maps and sessions
         for (const auto& map_state : app_state.maps) {
             model::Map::Id map_id{map_state.map_id};
@@ -265,7 +326,7 @@ namespace application {
 
             // restoring dogs
             for (const auto& dog_state : map_state.dogs) {
-                model::Dog dog(dog_state.name, dog_state.id, 
+                model::Dog dog(dog_state.id, 
                                pos::Coordinate{dog_state.x, dog_state.y},
                                dog_state.bag_capacity);
 
@@ -306,7 +367,7 @@ namespace application {
                 }
                 dog.AddScore(dog_state.score);
                 
-                session.RestoreDog(std::move(dog));
+                session.RestoreDog(std::move(dog), dog_state.name);
             }
 
             // restoring loot items
@@ -333,7 +394,11 @@ namespace application {
         // restoring players
         players_ = Players{};
         tokens_ = PlayerTokens{};
+        token_generation_.fetch_add(1, std::memory_order_release);
         next_player_id_ = app_state.auth.next_player_id;
+        for (auto& [map_id, timings] : player_timing_) {
+            timings.clear();
+        }
 
         for (const auto& player_link : app_state.auth.players) {
             model::Map::Id map_id{player_link.map_id};
@@ -343,18 +408,22 @@ namespace application {
             }
 
             auto& session = game_.GetSessionForMap(map_id);
-            const model::Dog* dog = session.GetDog(player_link.dog_id);
+            const auto dog = session.FindDogHandle(player_link.dog_id);
             if (!dog) {
                 throw std::runtime_error("Restoring state failed: dog not found");
             }
             Player::Id player_id = player_link.player_id;
-            players_.AddPlayer(player_id, dog, map_id);
+            players_.AddPlayer(player_id, session.GetDogName(player_link.dog_id), session, *dog);
 
-            player_timing_[player_id] = PlayerTiming{player_link.play_time_sec, player_link.idle_time_sec};
+            player_timing_.at(map_id)[player_id] = PlayerTiming{player_link.play_time_sec, player_link.idle_time_sec};
         }
 
         for (const auto& token_link : app_state.auth.tokens) {
-            tokens_.SetTokenForPlayer(token_link.token, token_link.player_id);
+            const auto token = Token::FromHex(token_link.token);
+            if (!token) {
+                throw std::runtime_error("Restoring state failed: invalid token");
+            }
+            tokens_.SetTokenForPlayer(*token, token_link.player_id);
         }
     }
 
@@ -362,43 +431,47 @@ namespace application {
         on_tick_callback_ = std::move(callback);
     }
 
-    void Application::Tick(std::chrono::milliseconds delta) {
-        // pre-tick
-        const double dt = std::chrono::duration<double>(delta).count();
+    void Application::SetOnMapTickCallback(OnMapTickCallback callback) {
+        on_map_tick_callback_ = std::move(callback);
+    }
 
-        std::unordered_map<Player::Id, bool> was_idle;
-        was_idle.reserve(players_.GetAllPlayers().size());
+    Application::IdlePlayers Application::BeginMapTick(const model::Map::Id& map_id, double dt) {
+        IdlePlayers was_idle;
+        auto& timings = player_timing_.at(map_id);
 
-        for (const auto& [player_id, player] : players_.GetAllPlayers()) {
+        ForEachPlayerInMap(map_id, [&](const Player& player) {
             const auto* dog = player.GetDog();
             if (!dog) {
-                continue;
+                return;
             }
             const auto& v = dog->GetVelocity();
-            was_idle[player_id] = (v.vx == 0.0 && v.vy == 0.0);
+            if (v.vx == 0.0 && v.vy == 0.0) {
+                was_idle.insert(player.GetId());
+            }
 
-            auto& timing = player_timing_[player_id];
+            auto& timing = timings[player.GetId()];
             timing.play_time_sec += dt;
-        }
+        });
 
-        // tick
-        game_.Tick(delta);        
+        return was_idle;
+    }
 
-        // post-tick
-        std::vector<Player::Id> to_retire;
-        for (const auto& [player_id, player] : players_.GetAllPlayers()) {
+    void Application::EndMapTick(const model::Map::Id& map_id, double dt, const IdlePlayers& was_idle, 
+                                 std::vector<Player::Id>& to_retire) {
+        auto& timings = player_timing_.at(map_id);
+
+        ForEachPlayerInMap(map_id, [&](const Player& player) {
             const auto* dog = player.GetDog();
             if (!dog) {
-                continue;
+                return;
             }
 
             const auto& v = dog->GetVelocity();
             const bool is_idle = (v.vx == 0.0 && v.vy == 0.0);
-            auto& timing = player_timing_[player_id];
+            auto& timing = timings[player.GetId()];
 
             if (is_idle) {
-                const bool was_idle_before = was_idle.contains(player_id) ? was_idle.at(player_id) : false;
-                if (was_idle_before) {
+                if (was_idle.contains(player.GetId())) {
                     timing.idle_time_sec += dt;
                 } 
                 else {
@@ -410,30 +483,105 @@ namespace application {
             }
 
             if (timing.idle_time_sec >= dog_retirement_time_sec_) {
-                to_retire.push_back(player_id);
+                to_retire.push_back(player.GetId());
+            }
+        });
+    }
+
+    void Application::Tick(std::chrono::milliseconds delta) {
+        std::exception_ptr tick_error;
+        {
+            std::unique_lock world_lock{world_mutex_};
+            const double dt = std::chrono::duration<double>(delta).count();
+
+            // pre-tick
+            std::vector<IdlePlayers> was_idle;
+            was_idle.reserve(game_.GetMaps().size());
+            for (const auto& map : game_.GetMaps()) {
+                was_idle.push_back(BeginMapTick(map.GetId(), dt));
+            }
+
+            // tick; a failed session does not hold back the retirements of the others,
+            // the error is rethrown once the tick is finished
+            try {
+                game_.Tick(delta);
+            } catch (...) {
+                tick_error = std::current_exception();
+            }
+
+            // post-tick
+            std::vector<Player::Id> to_retire;
+            size_t map_index = 0;
+            for (const auto& map : game_.GetMaps()) {
+                EndMapTick(map.GetId(), dt, was_idle[map_index++], to_retire);
+            }
+
+            for (auto player_id : to_retire) {
+                RetirePlayer(player_id);
+            }
+        }
+
+        // the callbacks may take a state snapshot, so they run without the lock
+        if (on_map_tick_callback_) {
+            for (const auto& map : game_.GetMaps()) {
+                on_map_tick_callback_(map.GetId());
+            }
+        }
+        FinishTick(delta);
+
+        if (tick_error) {
+            std::rethrow_exception(tick_error);
+        }
+    }
+
+    void Application::TickMap(const model::Map::Id& map_id, std::chrono::milliseconds delta) {
+        {
+            const auto access = LockMapAccess();
+            const double dt = std::chrono::duration<double>(delta).count();
+
+            const IdlePlayers was_idle = BeginMapTick(map_id, dt);
+            game_.GetSessionForMap(map_id).Tick(delta);
+
+            std::vector<Player::Id> to_retire;
+            EndMapTick(map_id, dt, was_idle, to_retire);
+
+            for (auto player_id : to_retire) {
+                RetirePlayer(player_id);
             }
         }
 
-        for (auto player_id : to_retire) {
-            RetirePlayer(player_id);
+        if (on_map_tick_callback_) {
+            on_map_tick_callback_(map_id);
         }
+    }
 
+    void Application::FinishTick(std::chrono::milliseconds delta) {
         if (on_tick_callback_) {
             on_tick_callback_(delta);
         }
     }
 
     void Application::SaveRetiredPlayerRecord(const PlayerRecord& record) {
-        auto uow = uow_factory_.Create();
-        uow->GetRecords().AddRecord(record);
-        uow->Commit();
+        records_writer_.Enqueue(record);
     }
 
     std::vector<PlayerRecord> Application::GetPlayerRecords(std::size_t start, std::size_t max_items) {
+        // players retired before the request are expected in the records
+        records_writer_.Flush();
+
+        if (auto page = leaderboard_.GetPage(start, max_items)) {
+            return std::move(page->records);
+        }
+
         auto uow = uow_factory_.Create();
         auto result = uow->GetRecords().GetRecords(start, max_items);
         uow->Commit();
         return result;
     }
 
+    std::optional<uint64_t> Application::GetPlayerRecordsVersion(std::size_t start, std::size_t max_items) {
+        records_writer_.Flush();
+        return leaderboard_.GetPageVersion(start, max_items);
+    }
+
 } // namespace application
\ No newline at end of file
@@ -7,34 +7,48 @@
 #include <memory>
 #include <chrono>
 #include <functional>
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_set>
 
 #include "../game_model/model.h"
 #include "../game_model/dog.h"
 #include "../game_model/loot_struct.h"
 #include "player.h"
+#include "token.h"
 #include "app_state.h"
 #include "unit_of_work.h"
+#include "leaderboard.h"
+#include "records_writer.h"
 
 namespace application {
 
 class Players {
 public:
-    Player& AddPlayer(const Player::Id id, const model::Dog* dog, const model::Map::Id& map_id);
+    Players() = default;
+    // the map index points into players_, so it is never copied, only moved
+    Players(const Players&) = delete;
+    Players& operator=(const Players&) = delete;
+    Players(Players&&) = default;
+    Players& operator=(Players&&) = default;
+
+    Player& AddPlayer(const Player::Id id, const std::string& name, model::GameSession& session, model::DogHandle dog);
     const Player* FindPlayerById(Player::Id id) const;
     const Player* FindPlayerByDogName(const std::string& dog_name) const;
 
-    void RemovePlayer(Player::Id id) {
-        players_.erase(id);
-    }
+    void RemovePlayer(Player::Id id);
 
-    std::vector<Player> GetPlayersInMap(const model::Map::Id& map_id) const {
-        std::vector<Player> result;
-        for (const auto& [id, player] : players_) {
-            if (player.GetMapId() == map_id) {
-                result.emplace_back(player);
-            }
+    // calls visitor(const Player&) for every player of the map, other maps are not looked at
+    template <typename Visitor>
+    void ForEachPlayerInMap(const model::Map::Id& map_id, Visitor&& visitor) const {
+        auto it = map_players_.find(map_id);
+        if (it == map_players_.end()) {
+            return;
+        }
+        for (const auto& [id, player] : it->second) {
+            visitor(*player);
         }
-        return result;
     }
 
     const std::unordered_map<Player::Id, Player>& GetAllPlayers() const {
@@ -43,43 +57,51 @@ public:
 
 private:
     std::unordered_map<Player::Id, Player> players_;
+    // players grouped by map, the nodes of players_ keep their addresses
+    std::unordered_map<model::Map::Id, std::unordered_map<Player::Id, const Player*>, 
+                       util::TaggedHasher<model::Map::Id>> map_players_;
 };
 
+// tokens are looked up by the token on every request and revoked by the player on retirement,
+// both directions are indexed
 class PlayerTokens {
 public:
-    using Token = std::string;
+    using TokenMap = std::unordered_map<Token, Player::Id, Token::Hasher>;
 
     void SetTokenForPlayer(const Token& token, Player::Id id);
     std::optional<Player::Id> FindPlayerByToken(const Token& token) const;
+    void RemoveTokensForPlayer(Player::Id id);
 
-    void RemoveTokensForPlayer(Player::Id id) {
-        for (auto it = tokens_.begin(); it != tokens_.end();) {
-            if (it->second == id) {
-                it = tokens_.erase(it);
-            } 
-            else {
-                ++it;
-            }
-        }
-    }
-
-    const std::unordered_map<Token, Player::Id>& GetAllTokens() const {
+    const TokenMap& GetAllTokens() const {
         return tokens_;
     }
 
 private:
-    std::unordered_map<Token, Player::Id> tokens_;    
+    TokenMap tokens_;
+    std::unordered_multimap<Player::Id, Token> player_tokens_;
 };
 
+// Every map is served by its own executor: calls that touch a single map (join, move,
+// players/state queries, TickMap) must run on the executor of that map while holding
+// the shared access returned by LockMapAccess. Tick and GetState work with all maps at once
+// and take exclusive access themselves. The players and tokens registry is shared between maps
+// and is guarded by its own mutex.
 class Application {
 public:
-    using Token = std::string;
     using OnTickCallback = std::function<void(std::chrono::milliseconds)>;
+    // called without holding access to the world once a map has been advanced
+    using OnMapTickCallback = std::function<void(const model::Map::Id&)>;
+    using MapAccess = std::shared_lock<std::shared_mutex>;
 
     struct JoinResult {
         Token token;
         Player::Id player_id;
     };
+
+    struct TokenOwner {
+        Player::Id player_id;
+        model::Map::Id map_id;
+    };
     
     struct PlayerTiming {
         double play_time_sec = 0.0;
@@ -90,44 +112,111 @@ public:
         : game_{game}
         , uow_factory_{uow_factory} {
             dog_retirement_time_sec_ = dog_retirement_time;
+
+            // the set of maps is fixed, so the outer container is never modified afterwards
+            // and maps can update their own timings concurrently
+            for (const auto& map : game_.GetMaps()) {
+                player_timing_[map.GetId()];
+            }
     }
 
+    // shared access for calls made on a map executor
+    [[nodiscard]] MapAccess LockMapAccess() const;
+
     JoinResult JoinGame(const std::string& dog_name, const std::string& map_id);
 
-    std::optional<Player::Id> FindPlayerIdByToken(const Token& token) const;
+    // player of the token and the map whose executor handles the player's requests
+    std::optional<TokenOwner> FindTokenOwner(const Token& token) const;
+    // changes whenever tokens are revoked; an owner found while the generation had some value
+    // stays valid for as long as the generation keeps it, so callers may cache lookups
+    uint64_t GetTokenGeneration() const {
+        return token_generation_.load(std::memory_order_acquire);
+    }
     const model::Map* FindMapByMapId(const model::Map::Id& id) const;
     const Player* FindPlayerById(Player::Id id) const;
 
     const std::deque<model::Map>& GetAllMaps() const;
-    std::vector<Player> GetPlayersInMap(const model::Map::Id& map_id) const;
+    // visits the players of the map under the registry lock,
+    // the visitor must not call back into the registry
+    template <typename Visitor>
+    void ForEachPlayerInMap(const model::Map::Id& map_id, Visitor&& visitor) const {
+        std::shared_lock registry_lock{registry_mutex_};
+        players_.ForEachPlayerInMap(map_id, std::forward<Visitor>(visitor));
+    }
     std::vector<model::LootItem> GetItemsInMap(const model::Map::Id& map_id) const;
+    // version of the map state, equal versions mean equal players and loot
+    uint64_t GetMapStateVersion(const model::Map::Id& map_id) const;
+    // dogs and loot changed after the version, nullopt when a full state is needed
+    // dog ids are the ids of their players
+    std::optional<model::StateDelta> GetMapChangesSince(const model::Map::Id& map_id, uint64_t version) const;
+    // read-only view of the map session for serializers, valid on the executor of the map
+    const model::GameSession& GetMapSession(const model::Map::Id& map_id) const;
     AppState GetState() const;
 
     void RestoreState(const AppState& app_state);
 
     void SetOnTickCallback(OnTickCallback callback);
+    void SetOnMapTickCallback(OnMapTickCallback callback);
 
+    // advances all maps under exclusive access and notifies the tick callback
     void Tick(std::chrono::milliseconds delta);
 
+    // advances a single map, must be called on the executor of the map;
+    // FinishTick notifies the tick callback once every map has been advanced
+    void TickMap(const model::Map::Id& map_id, std::chrono::milliseconds delta);
+    void FinishTick(std::chrono::milliseconds delta);
+
     void MovePlayer(Player::Id player_id, const pos::Direction& dir);
     void StopPlayer(Player::Id player_id);
 
+    // the record is written to the database in the background, it never blocks the tick
     void SaveRetiredPlayerRecord(const PlayerRecord& record);
+    // new players are not accepted while retired ones cannot be saved fast enough
+    bool IsRecordsBacklogged() const {
+        return records_writer_.IsBacklogged();
+    }
+    // pages inside the leaderboard are answered from memory, the rest from the database
     std::vector<PlayerRecord> GetPlayerRecords(std::size_t start, std::size_t max_items);
+    // version of the leaderboard if it answers the page, it changes together with the page
+    std::optional<uint64_t> GetPlayerRecordsVersion(std::size_t start, std::size_t max_items);
 
 private:
+    using PlayerTimings = std::unordered_map<Player::Id, PlayerTiming>;
+    using MapIdHasher = util::TaggedHasher<model::Map::Id>;
+    // players that stood still before the tick
+    using IdlePlayers = std::unordered_set<Player::Id>;
+
+    // pre-tick and post-tick passes over the players of one map
+    IdlePlayers BeginMapTick(const model::Map::Id& map_id, double dt);
+    void EndMapTick(const model::Map::Id& map_id, double dt, const IdlePlayers& was_idle, 
+                    std::vector<Player::Id>& to_retire);
+
     void RetirePlayer(Player::Id player_id);
 
 private:
     model::Game& game_;
     UnitOfWorkFactory& uow_factory_;
+
+    mutable std::shared_mutex world_mutex_;
+    mutable std::shared_mutex registry_mutex_;
+
+    // guarded by registry_mutex_
     Players players_;
     PlayerTokens tokens_;
     Player::Id next_player_id_ = 0;
+    // bumped under registry_mutex_ after tokens are removed
+    std::atomic<uint64_t> token_generation_ = 0;
+
     double dog_retirement_time_sec_ = 60.0;
-    std::unordered_map<Player::Id, PlayerTiming> player_timing_;
+    // timings of the players grouped by map, each group is updated on the executor of its map
+    std::unordered_map<model::Map::Id, PlayerTimings, MapIdHasher> player_timing_;
 
     OnTickCallback on_tick_callback_;
+    OnMapTickCallback on_map_tick_callback_;
+
+    Leaderboard leaderboard_;
+    // last, so the queued records are written out before anything else goes away
+    RecordsWriter records_writer_{uow_factory_, leaderboard_};
 };
 
 } // namespace application
\ No newline at end of file
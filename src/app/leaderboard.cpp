@@ -0,0 +1,90 @@
+#include "leaderboard.h"
+
+#include <algorithm>
+#include <mutex>
+#include <tuple>
+
+namespace {
+
+using namespace application;
+
+// the ORDER BY of the records query, which compares names bytewise with COLLATE "C"
+bool IsBetter(const PlayerRecord& lhs, const PlayerRecord& rhs) {
+    return std::tie(rhs.score, lhs.play_time, lhs.name) < std::tie(lhs.score, rhs.play_time, rhs.name);
+}
+
+} // namespace
+
+namespace application {
+
+std::optional<Leaderboard::Page> Leaderboard::GetPage(std::size_t start, std::size_t max_items) const {
+    std::shared_lock lock{mutex_};
+    if (!Contains(start, max_items)) {
+        return std::nullopt;
+    }
+
+    Page page;
+    page.version = version_;
+    if (start < records_.size()) {
+        const std::size_t end = start + std::min(max_items, records_.size() - start);
+        page.records.assign(records_.begin() + static_cast<std::ptrdiff_t>(start),
+                            records_.begin() + static_cast<std::ptrdiff_t>(end));
+    }
+    return page;
+}
+
+std::optional<std::uint64_t> Leaderboard::GetPageVersion(std::size_t start, std::size_t max_items) const {
+    std::shared_lock lock{mutex_};
+    if (!Contains(start, max_items)) {
+        return std::nullopt;
+    }
+    return version_;
+}
+
+void Leaderboard::Reset(std::vector<PlayerRecord> records) {
+    std::unique_lock lock{mutex_};
+    complete_ = records.size() <= capacity_;
+    if (!complete_) {
+        records.resize(capacity_);
+    }
+    records_ = std::move(records);
+    loaded_ = true;
+    ++version_;
+}
+
+void Leaderboard::Add(const std::vector<PlayerRecord>& records) {
+    std::unique_lock lock{mutex_};
+    if (!loaded_) {
+        return;
+    }
+
+    bool changed = false;
+    for (const auto& record : records) {
+        auto it = std::upper_bound(records_.begin(), records_.end(), record, IsBetter);
+        if (it == records_.end() && !complete_) {
+            // below the known part, the table has better records that are not kept
+            continue;
+        }
+        records_.insert(it, record);
+        changed = true;
+
+        if (records_.size() > capacity_) {
+            records_.pop_back();
+            complete_ = false;
+        }
+    }
+
+    if (changed) {
+        ++version_;
+    }
+}
+
+bool Leaderboard::Contains(std::size_t start, std::size_t max_items) const {
+    if (!loaded_) {
+        return false;
+    }
+    // a page beyond the end of a complete table is empty
+    return complete_ || (start <= records_.size() && max_items <= records_.size() - start);
+}
+
+}  // namespace application
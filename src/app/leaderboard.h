@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <shared_mutex>
+#include <vector>
+
+#include "records_repository.h"
+
+namespace application {
+
+// the best records kept in memory in the order of the records table:
+// score descending, then play time and name ascending
+// it is filled from the database and updated by the records writer as batches are committed;
+// pages inside the known part are answered without the database
+class Leaderboard {
+public:
+    static constexpr std::size_t kDefaultCapacity = 1000;
+
+    struct Page {
+        std::vector<PlayerRecord> records;
+        // changes whenever the leaderboard does
+        std::uint64_t version = 0;
+    };
+
+    explicit Leaderboard(std::size_t capacity = kDefaultCapacity)
+        : capacity_{capacity} {
+    }
+
+    // nullopt if the page reaches past the records kept in memory or nothing is loaded yet
+    std::optional<Page> GetPage(std::size_t start, std::size_t max_items) const;
+    // version of the page if it is known, see GetPage
+    std::optional<std::uint64_t> GetPageVersion(std::size_t start, std::size_t max_items) const;
+
+    // replaces the contents with the first records of the table,
+    // records holds at most capacity + 1 of them, so it is known whether the table has more
+    void Reset(std::vector<PlayerRecord> records);
+    // merges committed records
+    void Add(const std::vector<PlayerRecord>& records);
+
+    std::size_t GetCapacity() const {
+        return capacity_;
+    }
+
+private:
+    bool Contains(std::size_t start, std::size_t max_items) const;
+
+    const std::size_t capacity_;
+
+    mutable std::shared_mutex mutex_;
+    std::vector<PlayerRecord> records_;
+    // the table has no records beyond records_
+    bool complete_ = false;
+    bool loaded_ = false;
+    std::uint64_t version_ = 0;
+};
+
+}  // namespace application
@@ -7,31 +7,36 @@
 
 #include "../game_model/map.h"
 #include "../game_model/dog.h"
+#include "../game_model/game_session.h"
 #include "../game_model/loot_struct.h"
 
 namespace application {
 
+// the player refers to its dog by a handle of the map session,
+// GetDog returns nullptr once the dog is removed
 class Player {
 public:
     using Id = std::uint64_t;
 
-    Player(Id id, const model::Dog* dog, model::Map::Id map_id)
+    Player(Id id, std::string name, model::GameSession& session, model::DogHandle dog)
         : id_{id}
-        , dog_{dog}
-        , map_id_{std::move(map_id)} {
+        , name_{std::move(name)}
+        , session_{&session}
+        , dog_{dog} {
     }
 
     Id GetId() const;
+    const std::string& GetName() const;
     const pos::Position& GetPosition() const;
-    const model::Dog* GetDog() const;
-    std::vector<std::pair<size_t, size_t>> GetCollectedItems() const;
+    model::Dog* GetDog() const;
     int GetScore() const;
     const model::Map::Id& GetMapId() const;
 
 private:
     Id id_;
-    const model::Dog* dog_;
-    model::Map::Id map_id_;
+    std::string name_;
+    model::GameSession* session_;
+    model::DogHandle dog_;
 };
 
 } // namespace application
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstddef>
+#include <stdexcept>
 #include <string>
 #include <vector>
 
@@ -12,9 +13,18 @@ struct PlayerRecord {
     double play_time = 0.0;
 };
 
+// the database refused the records themselves, e.g. a value out of range or a violated constraint;
+// writing the same records again fails the same way, unlike a lost connection
+class RecordsRejectedError : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
 class RecordsRepository {
 public:
+    // both throw RecordsRejectedError if the records cannot be written at all
     virtual void AddRecord(const PlayerRecord& record) = 0;
+    virtual void AddRecords(const std::vector<PlayerRecord>& records) = 0;
     virtual std::vector<PlayerRecord> GetRecords(std::size_t start, std::size_t max_items) = 0;
 
     virtual ~RecordsRepository() = default;
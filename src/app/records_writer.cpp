@@ -0,0 +1,211 @@
+#include "records_writer.h"
+
+#include <algorithm>
+#include <exception>
+#include <iterator>
+#include <string>
+#include <string_view>
+
+#include "../detail/logger.h"
+
+namespace {
+
+constexpr std::string_view kLogWhere = "records writer";
+
+} // namespace
+
+namespace application {
+
+RecordsWriter::RecordsWriter(UnitOfWorkFactory& uow_factory, Leaderboard& leaderboard, std::size_t capacity,
+                             std::size_t batch_size)
+    : uow_factory_{uow_factory}
+    , leaderboard_{leaderboard}
+    , capacity_{std::max<std::size_t>(capacity, 1)}
+    , batch_size_{std::max<std::size_t>(batch_size, 1)}
+    , worker_{[this] { Run(); }} {
+}
+
+RecordsWriter::~RecordsWriter() {
+    {
+        std::lock_guard lock{mutex_};
+        stopping_ = true;
+    }
+    queued_cv_.notify_all();
+    worker_.join();
+}
+
+bool RecordsWriter::Enqueue(PlayerRecord record) {
+    std::unique_lock lock{mutex_};
+    if (queue_.size() >= capacity_) {
+        // it is called from ticks, which must not wait for the database
+        if (dropped_count_++ == 0) {
+            logger::LogError("records queue is full, record of " + record.name + " is dropped", kLogWhere);
+        }
+        return false;
+    }
+
+    queue_.push_back(std::move(record));
+    ++queued_count_;
+    lock.unlock();
+    queued_cv_.notify_one();
+    return true;
+}
+
+bool RecordsWriter::IsBacklogged() const {
+    std::lock_guard lock{mutex_};
+    return queue_.size() >= capacity_ / 2;
+}
+
+void RecordsWriter::Flush() {
+    std::unique_lock lock{mutex_};
+    const std::uint64_t target = queued_count_;
+    done_cv_.wait(lock, [this, target] {
+        return done_count_ >= target || failing_;
+    });
+}
+
+void RecordsWriter::Run() {
+    std::vector<PlayerRecord> batch;
+    auto pause = kMinRetryPause;
+    int attempts_on_stop = 0;
+    // the leaderboard is loaded first thing
+    auto next_reload = Clock::now();
+
+    std::unique_lock lock{mutex_};
+    while (true) {
+        if (batch.empty()) {
+            if (!stopping_ && Clock::now() >= next_reload) {
+                // reloads happen on this thread only, so they never race with merging batches
+                lock.unlock();
+                ReloadLeaderboard();
+                lock.lock();
+                next_reload = Clock::now() + kDefaultReloadInterval;
+            }
+
+            queued_cv_.wait_until(lock, next_reload, [this] {
+                return stopping_ || !queue_.empty();
+            });
+            if (queue_.empty()) {
+                if (stopping_) {
+                    return;
+                }
+                continue;
+            }
+
+            const auto count = static_cast<std::ptrdiff_t>(std::min(batch_size_, queue_.size()));
+            batch.assign(std::make_move_iterator(queue_.begin()), std::make_move_iterator(queue_.begin() + count));
+            queue_.erase(queue_.begin(), queue_.begin() + count);
+            if (dropped_count_ > 0) {
+                logger::LogError(std::to_string(dropped_count_) + " records were dropped on a full queue", kLogWhere);
+                dropped_count_ = 0;
+            }
+        }
+
+        lock.unlock();
+        const std::size_t batch_size = batch.size();
+        const bool written = WriteBatch(batch);
+        lock.lock();
+
+        done_count_ += batch_size - batch.size();
+        if (written) {
+            failing_ = false;
+            pause = kMinRetryPause;
+            done_cv_.notify_all();
+            continue;
+        }
+
+        failing_ = true;
+        done_cv_.notify_all();
+
+        if (stopping_ && ++attempts_on_stop >= kAttemptsOnStop) {
+            // the database is gone, nobody is left to wait for the rest
+            logger::LogError(std::to_string(batch.size() + queue_.size()) + " records are dropped on stop", kLogWhere);
+            done_count_ += batch.size() + queue_.size();
+            batch.clear();
+            queue_.clear();
+            done_cv_.notify_all();
+            return;
+        }
+
+        // the same batch is retried, a stop request cuts the pause short
+        queued_cv_.wait_for(lock, pause, [this] {
+            return stopping_;
+        });
+        pause = std::min<std::chrono::milliseconds>(pause * 2, kMaxRetryPause);
+    }
+}
+
+bool RecordsWriter::WriteBatch(std::vector<PlayerRecord>& batch) {
+    switch (Write(batch)) {
+    case WriteResult::Written:
+        // before the batch is counted as done, so a flushed reader finds it in the leaderboard
+        leaderboard_.Add(batch);
+        batch.clear();
+        return true;
+    case WriteResult::Failed:
+        return false;
+    case WriteResult::Rejected:
+        break;
+    }
+
+    // some record of the batch is refused, the others are written without it
+    std::vector<PlayerRecord> written;
+    std::vector<PlayerRecord> failed;
+    for (auto& record : batch) {
+        if (!failed.empty()) {
+            // the connection is lost, the rest waits for the retry
+            failed.push_back(std::move(record));
+            continue;
+        }
+
+        std::vector<PlayerRecord> single{record};
+        switch (Write(single)) {
+        case WriteResult::Written:
+            written.push_back(std::move(record));
+            break;
+        case WriteResult::Rejected:
+            logger::LogError("record of " + record.name + " is dropped", kLogWhere);
+            break;
+        case WriteResult::Failed:
+            failed.push_back(std::move(record));
+            break;
+        }
+    }
+
+    leaderboard_.Add(written);
+    batch = std::move(failed);
+    return batch.empty();
+}
+
+RecordsWriter::WriteResult RecordsWriter::Write(const std::vector<PlayerRecord>& records) {
+    try {
+        auto uow = uow_factory_.Create();
+        uow->GetRecords().AddRecords(records);
+        uow->Commit();
+        return WriteResult::Written;
+    }
+    catch (const RecordsRejectedError& ex) {
+        logger::LogError(ex.what(), kLogWhere);
+        return WriteResult::Rejected;
+    }
+    catch (const std::exception& ex) {
+        logger::LogError(ex.what(), kLogWhere);
+        return WriteResult::Failed;
+    }
+}
+
+void RecordsWriter::ReloadLeaderboard() {
+    try {
+        auto uow = uow_factory_.Create();
+        // one record past the capacity tells whether the table has more
+        auto records = uow->GetRecords().GetRecords(0, leaderboard_.GetCapacity() + 1);
+        uow->Commit();
+        leaderboard_.Reset(std::move(records));
+    }
+    catch (const std::exception& ex) {
+        // the leaderboard keeps what it has, the next reload tries again
+        logger::LogError(ex.what(), kLogWhere);
+    }
+}
+
+}  // namespace application
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "leaderboard.h"
+#include "records_repository.h"
+#include "unit_of_work.h"
+
+namespace application {
+
+// writes records of retired players on a background thread, so ticks never wait for the database;
+// queued records are written in batches, one transaction per batch;
+// the queue is bounded and a record that does not fit is dropped and logged rather than waited for,
+// callers are expected to slow the inflow down themselves once IsBacklogged() says so
+// a batch that failed on the connection is retried with a growing pause; a batch the database rejects
+// is written record by record and the rejected records are dropped; failures are logged
+// on destruction the queue is written out, and if the database is still failing at that point
+// the rest is dropped
+// committed batches are merged into the leaderboard, which is also reloaded from the database
+// on start and then periodically, so it follows changes made past this process
+class RecordsWriter {
+public:
+    static constexpr std::size_t kDefaultCapacity = 10'000;
+    static constexpr std::size_t kDefaultBatchSize = 256;
+
+    static constexpr auto kDefaultReloadInterval = std::chrono::seconds{60};
+
+    RecordsWriter(UnitOfWorkFactory& uow_factory, Leaderboard& leaderboard, std::size_t capacity = kDefaultCapacity,
+                  std::size_t batch_size = kDefaultBatchSize);
+    ~RecordsWriter();
+
+    RecordsWriter(const RecordsWriter&) = delete;
+    RecordsWriter& operator=(const RecordsWriter&) = delete;
+
+    // never blocks; returns false if the queue is full and the record is dropped
+    bool Enqueue(PlayerRecord record);
+
+    // the queue is filled at least halfway, e.g. while the database is down;
+    // the rest of it is left for the records of players who are already in the game
+    bool IsBacklogged() const;
+
+    // waits until the records queued before the call are written;
+    // returns early while the database is failing, so readers see the error themselves
+    void Flush();
+
+private:
+    static constexpr auto kMinRetryPause = std::chrono::milliseconds{100};
+    static constexpr auto kMaxRetryPause = std::chrono::seconds{5};
+    static constexpr int kAttemptsOnStop = 3;
+
+    using Clock = std::chrono::steady_clock;
+
+    enum class WriteResult {
+        Written,
+        // the records are refused, retrying them is pointless
+        Rejected,
+        Failed
+    };
+
+    void Run();
+    // records that are written or dropped leave the batch, returns true if nothing is left to retry
+    bool WriteBatch(std::vector<PlayerRecord>& batch);
+    // one transaction
+    WriteResult Write(const std::vector<PlayerRecord>& records);
+    void ReloadLeaderboard();
+
+    UnitOfWorkFactory& uow_factory_;
+    Leaderboard& leaderboard_;
+    const std::size_t capacity_;
+    const std::size_t batch_size_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable queued_cv_;
+    std::condition_variable done_cv_;
+    std::deque<PlayerRecord> queue_;
+    // counters of queued records and records that were written or dropped
+    std::uint64_t queued_count_ = 0;
+    std::uint64_t done_count_ = 0;
+    // records dropped on a full queue since this was last logged
+    std::uint64_t dropped_count_ = 0;
+    bool failing_ = false;
+    bool stopping_ = false;
+
+    std::thread worker_;
+};
+
+}  // namespace application
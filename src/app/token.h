@@ -0,0 +1,99 @@
+#pragma once
+
+#include <array>
+#include <compare>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "../detail/random_gen.h"
+
+namespace application {
+
+// 128-bit player token, clients see it as 32 lowercase hex digits
+class Token {
+public:
+    static constexpr std::size_t kSize = 16;
+    static constexpr std::size_t kHexSize = kSize * 2;
+
+    using Bytes = std::array<std::uint8_t, kSize>;
+
+    Token() = default;
+
+    explicit Token(const Bytes& bytes)
+        : bytes_{bytes} {
+    }
+
+    static Token Generate() {
+        Bytes bytes;
+        for (std::size_t half = 0; half < 2; ++half) {
+            std::uint64_t value = detail::GenerateRandomInt<std::uint64_t>();
+            for (std::size_t i = 0; i < 8; ++i) {
+                bytes[half * 8 + 7 - i] = static_cast<std::uint8_t>(value & 0xFF);
+                value >>= 8;
+            }
+        }
+        return Token{bytes};
+    }
+
+    // nullopt unless the text is exactly kHexSize lowercase hex digits, as produced by ToHex
+    static std::optional<Token> FromHex(std::string_view hex) {
+        if (hex.size() != kHexSize) {
+            return std::nullopt;
+        }
+
+        auto digit = [](char ch) -> int {
+            if (ch >= '0' && ch <= '9') {
+                return ch - '0';
+            }
+            if (ch >= 'a' && ch <= 'f') {
+                return ch - 'a' + 10;
+            }
+            return -1;
+        };
+
+        Bytes bytes;
+        for (std::size_t i = 0; i < kSize; ++i) {
+            const int high = digit(hex[2 * i]);
+            const int low = digit(hex[2 * i + 1]);
+            if (high < 0 || low < 0) {
+                return std::nullopt;
+            }
+            bytes[i] = static_cast<std::uint8_t>((high << 4) | low);
+        }
+        return Token{bytes};
+    }
+
+    std::string ToHex() const {
+        static constexpr char kHex[] = "0123456789abcdef";
+        std::string hex(kHexSize, '0');
+        for (std::size_t i = 0; i < kSize; ++i) {
+            hex[2 * i] = kHex[bytes_[i] >> 4];
+            hex[2 * i + 1] = kHex[bytes_[i] & 0xF];
+        }
+        return hex;
+    }
+
+    const Bytes& GetBytes() const {
+        return bytes_;
+    }
+
+    auto operator<=>(const Token&) const = default;
+
+    // tokens are random and only the server creates them, so any 64 bits are a good hash
+    struct Hasher {
+        std::size_t operator()(const Token& token) const noexcept {
+            std::uint64_t value;
+            std::memcpy(&value, token.bytes_.data(), sizeof(value));
+            return static_cast<std::size_t>(value);
+        }
+    };
+
+private:
+    Bytes bytes_{};
+};
+
+} // namespace application
@@ -266,7 +266,7 @@ namespace {
         }
 
         map.SetDogSpeed(map_cfg.dog_speed.value_or(1.0));
-        map.RebuildRoadCellIndex();
+        map.RebuildRoadIntervalIndex();
 
         return map;
     }
@@ -4,82 +4,82 @@
 
 #include "../game_model/model.h"
 #include "../metadata/loot_data.h"
+#include "../detail/json_writer.h"
 
 namespace config {
 
 namespace json = boost::json;
 
-inline json::object MakeRoadAsJson(const model::Road& road) {
-    json::object road_obj;
+inline void WriteRoadJson(util::JsonWriter& writer, const model::Road& road) {
     model::Point start = road.GetStart();
     model::Point end = road.GetEnd();
-    road_obj["x0"] = start.x;
-    road_obj["y0"] = start.y;
+    writer.BeginObject();
+    writer.Key("x0").Value(start.x);
+    writer.Key("y0").Value(start.y);
 
     if (road.IsHorizontal()) {
-        road_obj["x1"] = end.x;
+        writer.Key("x1").Value(end.x);
     }
     else {
-        road_obj["y1"] = end.y;
+        writer.Key("y1").Value(end.y);
     }
-    
-    return road_obj;
+    writer.EndObject();
 }
 
-inline json::object MakeBuildingAsJson(const model::Building& building) {
-    json::object building_obj;
+inline void WriteBuildingJson(util::JsonWriter& writer, const model::Building& building) {
     const model::Rectangle& bounds = building.GetBounds();
-    building_obj["x"] = bounds.position.x;
-    building_obj["y"] = bounds.position.y;
-    building_obj["w"] = bounds.size.width;
-    building_obj["h"] = bounds.size.height;
-
-    return building_obj;
+    writer.BeginObject();
+    writer.Key("x").Value(bounds.position.x);
+    writer.Key("y").Value(bounds.position.y);
+    writer.Key("w").Value(bounds.size.width);
+    writer.Key("h").Value(bounds.size.height);
+    writer.EndObject();
 }
- 
-inline json::object MakeOfficeAsJson(const model::Office& office) {
-    json::object office_obj;
-    office_obj["id"] = static_cast<std::string>(*office.GetId());
+
+inline void WriteOfficeJson(util::JsonWriter& writer, const model::Office& office) {
     model::Point position = office.GetPosition();
-    office_obj["x"] = position.x;
-    office_obj["y"] = position.y;
     model::Offset offset = office.GetOffset();
-    office_obj["offsetX"] = offset.dx;
-    office_obj["offsetY"] = offset.dy;
-
-    return office_obj;
+    writer.BeginObject();
+    writer.Key("id").Value(*office.GetId());
+    writer.Key("x").Value(position.x);
+    writer.Key("y").Value(position.y);
+    writer.Key("offsetX").Value(offset.dx);
+    writer.Key("offsetY").Value(offset.dy);
+    writer.EndObject();
 }
 
-inline json::object GetMapAsJsonObject(const model::Map* map_ptr, const metadata::LootMetaPerMap& loot_metadata) {
-    json::object map;
-    map["id"] = static_cast<std::string>(*map_ptr->GetId());
-    map["name"] = map_ptr->GetName();
-    
-    json::array roads_array;
-    for (const auto& road : map_ptr->GetRoads()) {            
-        roads_array.push_back(MakeRoadAsJson(road));
+inline void WriteMapJson(util::JsonWriter& writer, const model::Map& map,
+                         const metadata::LootMetaPerMap& loot_metadata) {
+    writer.BeginObject();
+    writer.Key("id").Value(*map.GetId());
+    writer.Key("name").Value(map.GetName());
+
+    writer.Key("roads").BeginArray();
+    for (const auto& road : map.GetRoads()) {
+        WriteRoadJson(writer, road);
     }
-    map["roads"] = roads_array;
+    writer.EndArray();
 
-    json::array buildings_array;
-    for (const auto& building : map_ptr->GetBuildings()) {
-        buildings_array.push_back(MakeBuildingAsJson(building));
+    writer.Key("buildings").BeginArray();
+    for (const auto& building : map.GetBuildings()) {
+        WriteBuildingJson(writer, building);
     }
-    map["buildings"] = buildings_array;
+    writer.EndArray();
 
-    json::array offices_array;
-    for (const auto& office : map_ptr->GetOffices()) {
-        offices_array.push_back(MakeOfficeAsJson(office));
+    writer.Key("offices").BeginArray();
+    for (const auto& office : map.GetOffices()) {
+        WriteOfficeJson(writer, office);
     }
-    map["offices"] = offices_array;
+    writer.EndArray();
 
-    json::array items_array;
-    for (const auto& item : loot_metadata.items.at(static_cast<std::string>(*map_ptr->GetId()))) {
-        items_array.push_back(item);
+    // loot types are kept as loaded from the config
+    writer.Key("lootTypes").BeginArray();
+    for (const auto& item : loot_metadata.items.at(*map.GetId())) {
+        writer.Raw(json::serialize(item));
     }
-    map["lootTypes"] = items_array;
+    writer.EndArray();
 
-    return map;
+    writer.EndObject();
 }
 
-} // namespace config
\ No newline at end of file
+} // namespace config
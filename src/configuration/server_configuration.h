@@ -14,6 +14,7 @@ using namespace std::literals;
 struct Args {
     std::optional<int> tick_period_ms;
     std::optional<int> save_state_period_ms;
+    std::optional<unsigned> tick_threads;
     std::string config_file;
     std::string state_file;
     std::string www_root;
@@ -35,7 +36,8 @@ struct Args {
         ("www-root,w", po::value<std::string>()->value_name("dir"), "set static files root")
         ("randomize-spawn-points", "spawn dogs at random positions")
         ("state-file,f", po::value<std::string>()->value_name("state file"), "set path to save server state")
-        ("save-state-period,p", po::value<int>()->value_name("milliseconds"), "set period to save server state");
+        ("save-state-period,p", po::value<int>()->value_name("milliseconds"), "set period to save server state")
+        ("tick-threads", po::value<unsigned>()->value_name("threads"), "tick all maps together on a pool of threads, 0 or 1 ticks them one by one");
 
     // variables_map хранит значения опций после разбора
     po::variables_map vm;
@@ -56,6 +58,10 @@ struct Args {
         args.save_state_period_ms = vm["save-state-period"].as<int>();
     }
 
+    if (vm.count("tick-threads")) {
+        args.tick_threads = vm["tick-threads"].as<unsigned>();
+    }
+
     if (vm.count("config-file")) {
         args.config_file = vm["config-file"].as<std::string>();
     }
@@ -0,0 +1,200 @@
+#pragma once
+
+#include <cassert>
+#include <charconv>
+#include <cmath>
+#include <concepts>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace util {
+
+// appends JSON text to a string without building a document tree
+// commas and colons are placed automatically, the caller is responsible for balancing
+// Begin/End calls and for writing a key before every value inside an object
+class JsonWriter {
+public:
+    explicit JsonWriter(std::string& out)
+        : out_{out} {
+    }
+
+    JsonWriter& BeginObject() {
+        return Open('{');
+    }
+
+    JsonWriter& EndObject() {
+        return Close('}');
+    }
+
+    JsonWriter& BeginArray() {
+        return Open('[');
+    }
+
+    JsonWriter& EndArray() {
+        return Close(']');
+    }
+
+    JsonWriter& Key(std::string_view key) {
+        Separate();
+        WriteString(key);
+        out_.push_back(':');
+        after_key_ = true;
+        return *this;
+    }
+
+    // numeric keys such as player ids, written without a temporary string
+    template <std::integral T>
+    JsonWriter& Key(T key) {
+        Separate();
+        out_.push_back('"');
+        WriteNumber(key);
+        out_.append("\":");
+        after_key_ = true;
+        return *this;
+    }
+
+    JsonWriter& Value(std::string_view value) {
+        Separate();
+        WriteString(value);
+        return *this;
+    }
+
+    JsonWriter& Value(const char* value) {
+        return Value(std::string_view{value});
+    }
+
+    JsonWriter& Value(bool value) {
+        Separate();
+        out_.append(value ? "true" : "false");
+        return *this;
+    }
+
+    template <std::integral T>
+        requires (!std::same_as<T, bool>)
+    JsonWriter& Value(T value) {
+        Separate();
+        WriteNumber(value);
+        return *this;
+    }
+
+    // shortest representation that reads back to the same double,
+    // integral values keep a fraction so they stay floating point for clients;
+    // JSON has no infinities and NaN, they are written as null
+    JsonWriter& Value(double value) {
+        Separate();
+        if (!std::isfinite(value)) {
+            out_.append("null");
+            return *this;
+        }
+        char buf[32];
+        const auto [end, ec] = std::to_chars(buf, buf + sizeof(buf), value);
+        const std::string_view text{buf, static_cast<size_t>(end - buf)};
+        out_.append(text);
+        if (text.find_first_of(".eE") == std::string_view::npos) {
+            out_.append(".0");
+        }
+        return *this;
+    }
+
+    JsonWriter& Null() {
+        Separate();
+        out_.append("null");
+        return *this;
+    }
+
+    // already serialized JSON value
+    JsonWriter& Raw(std::string_view json) {
+        Separate();
+        out_.append(json);
+        return *this;
+    }
+
+private:
+    static constexpr int kMaxDepth = 63;
+
+    JsonWriter& Open(char bracket) {
+        Separate();
+        out_.push_back(bracket);
+        ++depth_;
+        assert(depth_ <= kMaxDepth);
+        has_items_ &= ~LevelBit();
+        return *this;
+    }
+
+    JsonWriter& Close(char bracket) {
+        assert(depth_ > 0 && !after_key_);
+        --depth_;
+        out_.push_back(bracket);
+        return *this;
+    }
+
+    // a comma before every element of a container except the first, nothing after a key
+    void Separate() {
+        if (after_key_) {
+            after_key_ = false;
+            return;
+        }
+        if (depth_ > 0) {
+            if (has_items_ & LevelBit()) {
+                out_.push_back(',');
+            }
+            has_items_ |= LevelBit();
+        }
+    }
+
+    uint64_t LevelBit() const {
+        return uint64_t{1} << depth_;
+    }
+
+    template <std::integral T>
+    void WriteNumber(T value) {
+        char buf[24];
+        const auto [end, ec] = std::to_chars(buf, buf + sizeof(buf), value);
+        out_.append(buf, end);
+    }
+
+    void WriteString(std::string_view value) {
+        static constexpr char kHex[] = "0123456789abcdef";
+
+        out_.push_back('"');
+        for (char ch : value) {
+            switch (ch) {
+                case '"':
+                    out_.append("\\\"");
+                    break;
+                case '\\':
+                    out_.append("\\\\");
+                    break;
+                case '\n':
+                    out_.append("\\n");
+                    break;
+                case '\r':
+                    out_.append("\\r");
+                    break;
+                case '\t':
+                    out_.append("\\t");
+                    break;
+                default:
+                    if (static_cast<unsigned char>(ch) < 0x20) {
+                        out_.append("\\u00");
+                        out_.push_back(kHex[(ch >> 4) & 0xF]);
+                        out_.push_back(kHex[ch & 0xF]);
+                    }
+                    else {
+                        out_.push_back(ch);
+                    }
+            }
+        }
+        out_.push_back('"');
+    }
+
+private:
+    std::string& out_;
+    int depth_ = 0;
+    // bit d is set when the container at depth d already has an element
+    uint64_t has_items_ = 0;
+    bool after_key_ = false;
+};
+
+} // namespace util
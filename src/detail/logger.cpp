@@ -79,6 +79,14 @@ namespace logger {
                                  << "error";
     }
 
+    void LogError(std::string_view text, std::string_view where) {
+        json::object data;
+        data["text"] = std::string(text);
+        data["where"] = std::string(where);
+        BOOST_LOG_TRIVIAL(error) << boost::log::add_value(additional_data.get_name(), data)
+                                 << "error";
+    }
+
     void LogRequest(std::string_view ip, std::string_view URI, std::string_view method) {
         json::object data;
         data["ip"] = std::string(ip);
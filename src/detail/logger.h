@@ -25,6 +25,8 @@ namespace logger {
     void LogServerStart(const int port, std::string_view address);
     void LogServerStop(const int code, std::string_view exception_text = {});
     void LogNetworkError(const int code, std::string_view text, std::string_view where);
+    // errors outside the network code, such as failed ticks or database writes
+    void LogError(std::string_view text, std::string_view where);
     void LogRequest(std::string_view ip, std::string_view URI, std::string_view method);
     void LogResponse(std::string_view ip, const int time, const int code, std::string_view content_type);
 
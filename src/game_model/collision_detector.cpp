@@ -1,8 +1,178 @@
 #include "collision_detector.h"
+#include <cmath>
 #include <ranges>
- 
+#include <utility>
+
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
 namespace model::collision_detector {
 
+namespace {
+
+struct GridCell {
+    int x = 0;
+    int y = 0;
+
+    auto operator<=>(const GridCell&) const = default;
+};
+
+// hit of the narrow phase, index refers to the provider's item order
+struct Candidate {
+    size_t index;
+    double sq_distance;
+    double proj_ratio;
+};
+
+// items fetched from the provider once, positions and widths are kept as structure of arrays
+// in the order chosen by the owner, index maps a slot back to the provider's item index
+class ItemBatch {
+public:
+    explicit ItemBatch(const ItemGathererProvider& provider) {
+        const size_t items_num = provider.ItemsCount();
+        items_.reserve(items_num);
+        for (size_t i = 0; i < items_num; ++i) {
+            items_.push_back(provider.GetItem(i));
+        }
+    }
+
+    const Item& GetItem(size_t index) const {
+        return items_[index];
+    }
+
+    size_t Size() const {
+        return items_.size();
+    }
+
+    // lays out the arrays in the given order of item indices
+    void Arrange(const std::vector<size_t>& order) {
+        index_ = order;
+        x_.resize(order.size());
+        y_.resize(order.size());
+        width_.resize(order.size());
+        for (size_t slot = 0; slot < order.size(); ++slot) {
+            const Item& item = items_[order[slot]];
+            x_[slot] = item.position.x;
+            y_[slot] = item.position.y;
+            width_[slot] = item.width;
+        }
+        sq_distances_.resize(order.size());
+        proj_ratios_.resize(order.size());
+    }
+
+    // tests the gatherer against slots [begin, end) and appends the collected ones
+    void Collect(const Gatherer& gatherer, size_t begin, size_t end, std::vector<Candidate>& out) {
+        const size_t count = end - begin;
+        TryCollectPoints(gatherer.start_pos, gatherer.end_pos,
+                         std::span{x_}.subspan(begin, count), std::span{y_}.subspan(begin, count),
+                         std::span{sq_distances_}.subspan(begin, count), std::span{proj_ratios_}.subspan(begin, count));
+
+        for (size_t slot = begin; slot < end; ++slot) {
+            CollectionResult result(sq_distances_[slot], proj_ratios_[slot]);
+            if (result.IsCollected(gatherer.width + width_[slot])) {
+                out.push_back({index_[slot], result.sq_distance, result.proj_ratio});
+            }
+        }
+    }
+
+private:
+    std::vector<Item> items_;
+    std::vector<size_t> index_;
+    std::vector<double> x_;
+    std::vector<double> y_;
+    std::vector<double> width_;
+    std::vector<double> sq_distances_;
+    std::vector<double> proj_ratios_;
+};
+
+// items sorted by cell, all cells of one grid column occupy a contiguous range of slots
+// so a rectangle of cells is visited with one binary search per column
+class ItemGrid {
+public:
+    ItemGrid(ItemBatch& batch, double cell_size)
+        : cell_size_{cell_size} {
+        std::vector<std::pair<GridCell, size_t>> entries;
+        entries.reserve(batch.Size());
+        for (size_t i = 0; i < batch.Size(); ++i) {
+            const Item& item = batch.GetItem(i);
+            entries.emplace_back(ToCell(item.position.x, item.position.y), i);
+            max_item_width_ = std::max(max_item_width_, item.width);
+        }
+        std::ranges::sort(entries);
+
+        std::vector<size_t> order;
+        order.reserve(entries.size());
+        cells_.reserve(entries.size());
+        for (const auto& [cell, index] : entries) {
+            cells_.push_back(cell);
+            order.push_back(index);
+        }
+        batch.Arrange(order);
+    }
+
+    double GetMaxItemWidth() const {
+        return max_item_width_;
+    }
+
+    // calls fn(begin, end) for contiguous ranges of slots whose cells intersect the rectangle
+    template <typename Fn>
+    void ForEachRangeInArea(double min_x, double min_y, double max_x, double max_y, Fn&& fn) const {
+        const GridCell from = ToCell(min_x, min_y);
+        const GridCell to = ToCell(max_x, max_y);
+        const auto inside = [&](const GridCell& cell) {
+            return cell.x >= from.x && cell.x <= to.x && cell.y >= from.y && cell.y <= to.y;
+        };
+
+        // a wide rectangle is cheaper to check against every item
+        if (static_cast<size_t>(to.x - from.x) >= cells_.size()) {
+            size_t slot = 0;
+            while (slot < cells_.size()) {
+                if (!inside(cells_[slot])) {
+                    ++slot;
+                    continue;
+                }
+                const size_t begin = slot;
+                while (slot < cells_.size() && inside(cells_[slot])) {
+                    ++slot;
+                }
+                fn(begin, slot);
+            }
+            return;
+        }
+
+        for (int x = from.x; x <= to.x; ++x) {
+            auto first = std::ranges::lower_bound(cells_, GridCell{x, from.y});
+            auto last = first;
+            while (last != cells_.end() && last->x == x && last->y <= to.y) {
+                ++last;
+            }
+            if (first != last) {
+                fn(static_cast<size_t>(first - cells_.begin()), static_cast<size_t>(last - cells_.begin()));
+            }
+        }
+    }
+
+private:
+    GridCell ToCell(double x, double y) const {
+        return {static_cast<int>(std::floor(x / cell_size_)), static_cast<int>(std::floor(y / cell_size_))};
+    }
+
+    double cell_size_;
+    double max_item_width_ = 0.0;
+    std::vector<GridCell> cells_;
+};
+
+void AppendEvents(const ItemBatch& batch, const Gatherer& gatherer,
+                  const std::vector<Candidate>& candidates, std::vector<GatheringEvent>& events) {
+    for (const auto& candidate : candidates) {
+        const Item& item_obj = batch.GetItem(candidate.index);
+        events.emplace_back(item_obj.kind, item_obj.id, gatherer.id, candidate.sq_distance, candidate.proj_ratio);
+    }
+}
+
+} // namespace
+
 CollectionResult TryCollectPoint(pos::Coordinate a, pos::Coordinate b, pos::Coordinate c) {
     const double u_x = c.x - a.x;
     const double u_y = c.y - a.y;
@@ -17,32 +187,119 @@ CollectionResult TryCollectPoint(pos::Coordinate a, pos::Coordinate b, pos::Coor
     return CollectionResult(sq_distance, proj_ratio);
 }
 
+// every lane performs the same operations in the same order as TryCollectPoint
+void TryCollectPoints(pos::Coordinate a, pos::Coordinate b,
+                      std::span<const double> xs, std::span<const double> ys,
+                      std::span<double> sq_distances, std::span<double> proj_ratios) {
+    const size_t count = xs.size();
+    const double v_x = b.x - a.x;
+    const double v_y = b.y - a.y;
+    const double v_len2 = v_x * v_x + v_y * v_y;
+    size_t i = 0;
+
+#if defined(__AVX__)
+    {
+        const __m256d a_x = _mm256_set1_pd(a.x);
+        const __m256d a_y = _mm256_set1_pd(a.y);
+        const __m256d v_x4 = _mm256_set1_pd(v_x);
+        const __m256d v_y4 = _mm256_set1_pd(v_y);
+        const __m256d v_len2_4 = _mm256_set1_pd(v_len2);
+        for (; i + 4 <= count; i += 4) {
+            const __m256d u_x = _mm256_sub_pd(_mm256_loadu_pd(xs.data() + i), a_x);
+            const __m256d u_y = _mm256_sub_pd(_mm256_loadu_pd(ys.data() + i), a_y);
+            const __m256d u_dot_v = _mm256_add_pd(_mm256_mul_pd(u_x, v_x4), _mm256_mul_pd(u_y, v_y4));
+            const __m256d u_len2 = _mm256_add_pd(_mm256_mul_pd(u_x, u_x), _mm256_mul_pd(u_y, u_y));
+            const __m256d proj = _mm256_div_pd(u_dot_v, v_len2_4);
+            const __m256d sq = _mm256_sub_pd(u_len2, _mm256_div_pd(_mm256_mul_pd(u_dot_v, u_dot_v), v_len2_4));
+            _mm256_storeu_pd(proj_ratios.data() + i, proj);
+            _mm256_storeu_pd(sq_distances.data() + i, sq);
+        }
+    }
+#endif
+
+#if defined(__SSE2__)
+    {
+        const __m128d a_x = _mm_set1_pd(a.x);
+        const __m128d a_y = _mm_set1_pd(a.y);
+        const __m128d v_x2 = _mm_set1_pd(v_x);
+        const __m128d v_y2 = _mm_set1_pd(v_y);
+        const __m128d v_len2_2 = _mm_set1_pd(v_len2);
+        for (; i + 2 <= count; i += 2) {
+            const __m128d u_x = _mm_sub_pd(_mm_loadu_pd(xs.data() + i), a_x);
+            const __m128d u_y = _mm_sub_pd(_mm_loadu_pd(ys.data() + i), a_y);
+            const __m128d u_dot_v = _mm_add_pd(_mm_mul_pd(u_x, v_x2), _mm_mul_pd(u_y, v_y2));
+            const __m128d u_len2 = _mm_add_pd(_mm_mul_pd(u_x, u_x), _mm_mul_pd(u_y, u_y));
+            const __m128d proj = _mm_div_pd(u_dot_v, v_len2_2);
+            const __m128d sq = _mm_sub_pd(u_len2, _mm_div_pd(_mm_mul_pd(u_dot_v, u_dot_v), v_len2_2));
+            _mm_storeu_pd(proj_ratios.data() + i, proj);
+            _mm_storeu_pd(sq_distances.data() + i, sq);
+        }
+    }
+#endif
+
+    for (; i < count; ++i) {
+        const double u_x = xs[i] - a.x;
+        const double u_y = ys[i] - a.y;
+        const double u_dot_v = u_x * v_x + u_y * v_y;
+        const double u_len2 = u_x * u_x + u_y * u_y;
+        proj_ratios[i] = u_dot_v / v_len2;
+        sq_distances[i] = u_len2 - (u_dot_v * u_dot_v) / v_len2;
+    }
+}
+
 std::vector<GatheringEvent> FindGatherEvents(const ItemGathererProvider& provider) {
-    size_t items_num = provider.ItemsCount();
-    size_t gatherers_num = provider.GatherersCount();
+    ItemBatch batch{provider};
+    std::vector<size_t> order(batch.Size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    batch.Arrange(order);
+
+    const size_t gatherers_num = provider.GatherersCount();
     std::vector<GatheringEvent> events;
-    events.reserve(items_num * gatherers_num);
+    std::vector<Candidate> candidates;
 
     for (size_t g = 0; g < gatherers_num; ++g) {
-        const auto& gatherer = provider.GetGatherer(g);
-        for (size_t i = 0; i < items_num; ++i) {
-            const auto& item_obj = provider.GetItem(i);
-            CollectionResult result = TryCollectPoint(
-                gatherer.start_pos,
-                gatherer.end_pos,
-                item_obj.position
-            );
-            double collect_radius = (gatherer.width + item_obj.width);
-
-            if (result.IsCollected(collect_radius)) {
-                double time = result.proj_ratio;
-                events.emplace_back(item_obj.type, item_obj.id, gatherer.id, result.sq_distance, time);
-            }
-        }
+        const auto gatherer = provider.GetGatherer(g);
+        candidates.clear();
+        batch.Collect(gatherer, 0, batch.Size(), candidates);
+        AppendEvents(batch, gatherer, candidates, events);
+    }
+
+    std::ranges::stable_sort(events, {}, &GatheringEvent::time);
+    return events;
+}
+
+std::vector<GatheringEvent> FindGatherEventsInGrid(const ItemGathererProvider& provider, double cell_size) {
+    ItemBatch batch{provider};
+    const ItemGrid grid{batch, cell_size};
+
+    const size_t gatherers_num = provider.GatherersCount();
+    std::vector<GatheringEvent> events;
+    std::vector<Candidate> candidates;
+
+    for (size_t g = 0; g < gatherers_num; ++g) {
+        const auto gatherer = provider.GetGatherer(g);
+
+        // an item can be collected only inside the swept segment widened by the largest radius
+        const double reach = gatherer.width + grid.GetMaxItemWidth();
+        candidates.clear();
+        grid.ForEachRangeInArea(
+            std::min(gatherer.start_pos.x, gatherer.end_pos.x) - reach,
+            std::min(gatherer.start_pos.y, gatherer.end_pos.y) - reach,
+            std::max(gatherer.start_pos.x, gatherer.end_pos.x) + reach,
+            std::max(gatherer.start_pos.y, gatherer.end_pos.y) + reach,
+            [&](size_t begin, size_t end) {
+                batch.Collect(gatherer, begin, end, candidates);
+            });
+
+        // same item order as in the exhaustive search
+        std::ranges::sort(candidates, {}, &Candidate::index);
+        AppendEvents(batch, gatherer, candidates, events);
     }
 
-    std::ranges::sort(events, {}, &GatheringEvent::time);
+    std::ranges::stable_sort(events, {}, &GatheringEvent::time);
     return events;
 }
 
-}  // namespace collision_detector
\ No newline at end of file
+}  // namespace collision_detector
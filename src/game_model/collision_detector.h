@@ -3,6 +3,9 @@
 #include "../detail/position.h"
 
 #include <algorithm>
+#include <cstdint>
+#include <span>
+#include <type_traits>
 #include <vector>
  
 namespace model::collision_detector {
@@ -23,8 +26,22 @@ struct CollectionResult {
 // Эта функция реализована в уроке.
 CollectionResult TryCollectPoint(pos::Coordinate a, pos::Coordinate b, pos::Coordinate c);
 
+// batch version of TryCollectPoint for points c_i = (xs[i], ys[i]) given as structure of arrays
+// uses AVX/SSE2 when available, results are bit-identical to TryCollectPoint
+// as long as the compiler does not contract the scalar version into fma
+// output spans must be at least xs.size() long
+void TryCollectPoints(pos::Coordinate a, pos::Coordinate b,
+                      std::span<const double> xs, std::span<const double> ys,
+                      std::span<double> sq_distances, std::span<double> proj_ratios);
+
+// kind of a collectable object, new kinds are appended at the end
+enum class ItemKind : uint8_t {
+    Loot,
+    Office
+};
+
 struct Item {
-    std::string type;
+    ItemKind kind;
     pos::Coordinate position;
     double width;
     int id;
@@ -49,13 +66,23 @@ public:
 };
 
 struct GatheringEvent {
-    std::string item_type;
+    ItemKind item_kind;
     size_t item_id;
     size_t gatherer_id;
     double sq_distance;
     double time;
 };
 
+// items and events are copied and sorted on every tick, keep them free of heap data
+static_assert(std::is_trivially_copyable_v<Item>);
+static_assert(std::is_trivially_copyable_v<GatheringEvent>);
+
+// events are ordered by time, events with equal time keep the gatherer-major order
 std::vector<GatheringEvent> FindGatherEvents(const ItemGathererProvider& provider);
 
-}  // namespace model::collision_detector
\ No newline at end of file
+// broad-phase variant of FindGatherEvents: items are bucketed into a uniform grid
+// and each gatherer is tested only against the cells covered by its swept segment
+// returns the same events in the same order as FindGatherEvents
+std::vector<GatheringEvent> FindGatherEventsInGrid(const ItemGathererProvider& provider, double cell_size = 1.0);
+
+}  // namespace model::collision_detector
\ No newline at end of file
@@ -2,10 +2,6 @@
 
 namespace model {
 
-const std::string& Dog::GetName() const {
-    return name_;
-}
- 
 const pos::Position& Dog::GetPosition() const {
     return pos_;
 }
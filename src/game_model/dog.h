@@ -4,20 +4,18 @@
 #include "loot_struct.h"
 
 #include <vector>
-#include <string>
  
 namespace model {
     
+    // simulation state of a dog, the name is kept by the session apart from the hot data
     class Dog {
     public:
-        explicit Dog(std::string name, int id, pos::Coordinate&& coordinates, int bag_capacity)
-            : name_{std::move(name)}
-            , id_{id}
+        explicit Dog(int id, pos::Coordinate&& coordinates, int bag_capacity)
+            : id_{id}
             , pos_{pos::Position{std::move(coordinates), pos::Velocity{0, 0}, pos::Direction::NORTH}}
             , bag_capacity_{bag_capacity} {
         }
 
-        const std::string& GetName() const;
         const pos::Position& GetPosition() const;
         const pos::Coordinate& GetCoordinates() const;
         const pos::Velocity& GetVelocity() const;
@@ -37,7 +35,6 @@ namespace model {
         void AddScore(int score);        
 
     private:
-        std::string name_;
         int id_;
         pos::Position pos_;
         std::vector<std::pair<ItemId, LootInfo>> collected_items_;
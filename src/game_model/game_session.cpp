@@ -4,138 +4,11 @@
 #include <cmath>
 #include <unordered_set>
  
-// the road surface is treated as a widened corridor around the road axis
-// allowed movement is computed by projecting nearby road rectangles into 1d intervals
-// only roads near the current position are checked using the cell index
 namespace {
 
-static constexpr double kHalfWidth = 0.4;
-static constexpr double kEps = 1e-6;
-
-enum class RoadOrientation {
-    Horizontal,
-    Vertical
-};
-
-// axis-aligned rectangle in double coordinates used for road corridor checks
-struct RectD {
-    double min_x;
-    double max_x;
-    double min_y;
-    double max_y;
-};
-
-// 1d interval used to represent allowed movement ranges along one axis
-struct Interval {
-    double left;
-    double right;
-};
-
-static bool InRange(double v, double a, double b) {
-    return v >= a - kEps && v <= b + kEps;
-}
-
-static RectD RoadRect(const model::Road& road) {
-    if (road.IsHorizontal()) {
-        const double y = static_cast<double>(road.GetStart().y);
-        const double x0 = static_cast<double>(road.GetMinAlongAxis()) - kHalfWidth;
-        const double x1 = static_cast<double>(road.GetMaxAlongAxis()) + kHalfWidth;
-
-        return { x0, x1, y - kHalfWidth, y + kHalfWidth };
-    }
-
-    const double x = static_cast<double>(road.GetStart().x);
-    const double y0 = static_cast<double>(road.GetMinAlongAxis()) - kHalfWidth;
-    const double y1 = static_cast<double>(road.GetMaxAlongAxis()) + kHalfWidth;
-
-    return { x - kHalfWidth, x + kHalfWidth, y0, y1 };
-}
-
-// finds the interval that contains the current coordinate
-// if the coordinate is extremely close to a boundary, returns the nearest interval
-static const Interval* FindCurrentInterval(
-    double from,
-    const std::vector<Interval>& merged)
-{
-    const Interval* best = nullptr;
-    double best_dist = 1e100;
-
-    for (const auto& seg : merged) {
-        if (from >= seg.left - kEps && from <= seg.right + kEps) {
-            return &seg;
-        }
-
-        double dist = 0.0;
-        if (from < seg.left) {
-            dist = seg.left - from;
-        } else {
-            dist = from - seg.right;
-        }
-
-        if (dist < best_dist) {
-            best_dist = dist;
-            best = &seg;
-        }
-    }
-
-    if (best && best_dist <= kEps) {
-        return best;
-    }
-
-    return nullptr;
-}
-
-// builds allowed 1d intervals for movement along the specified orientation
-static std::vector<Interval> BuildIntervalsAlongRoadAxis(const model::Map& map, 
-                                const pos::Coordinate& from, RoadOrientation orientation) {
-    std::vector<Interval> result;
-    const auto& roads = map.GetRoads();
-    const auto candidates = map.GetRoadCandidates(from);
-
-    for (size_t idx : candidates) {
-        const auto& road = roads.at(idx);
-        const RectD r = RoadRect(road);
-
-        if (orientation == RoadOrientation::Horizontal) {
-            if (!InRange(from.y, r.min_y, r.max_y)) {
-                continue;
-            }
-            result.push_back({ r.min_x, r.max_x });
-        }
-        else {
-            if (!InRange(from.x, r.min_x, r.max_x)) {
-            continue;
-        }
-        result.push_back({ r.min_y, r.max_y });
-        }        
-    }
-
-    return result;
-}
-
-// clamps movement along one axis using a set of allowed intervals
-// movement is limited to the boundary of the current merged interval
-double RestrictInsideIntervals(double from, double to, std::vector<Interval> intervals) {
-    if (intervals.empty()) {
-        return from;
-    }
-
-    std::sort(intervals.begin(), intervals.end(),
-              [](const Interval& a, const Interval& b) {
-                  return a.left < b.left;
-              });
-
-    std::vector<Interval> merged;
-    for (const auto& seg : intervals) {
-        if (merged.empty() || seg.left > merged.back().right) {
-            merged.push_back(seg);
-        } else {
-            merged.back().right = std::max(merged.back().right, seg.right);
-        }
-    }
-
-    const Interval* current = FindCurrentInterval(from, merged);
-
+// clamps movement along one axis to the road interval that contains the start point
+double RestrictInsideInterval(double from, double to,
+                              const std::optional<model::RoadIntervalIndex::Interval>& current) {
     if (!current) {
         return from;
     }
@@ -151,16 +24,10 @@ namespace collision = model::collision_detector;
 
 class LootPickupProvider final : public collision::ItemGathererProvider {
 public:
-    LootPickupProvider(const model::LootStore& store)
-        : store_{store} {
-    }
-
-    LootPickupProvider(const model::LootStore& store,
-                       std::vector<collision::Item> items,
-                       std::vector<collision::Gatherer> gatherers)
-        : store_{store}
-        , items_{std::move(items)}
-        , gatherers_{std::move(gatherers)} {
+    LootPickupProvider(const std::vector<collision::Item>& items,
+                       const std::vector<collision::Gatherer>& gatherers)
+        : items_{items}
+        , gatherers_{gatherers} {
     }
 
     size_t ItemsCount() const override {
@@ -180,9 +47,8 @@ public:
     }
 
 private:
-    const model::LootStore& store_;
-    std::vector<collision::Item> items_;
-    std::vector<collision::Gatherer> gatherers_;
+    const std::vector<collision::Item>& items_;
+    const std::vector<collision::Gatherer>& gatherers_;
 };
 
 } // namespace
@@ -205,33 +71,68 @@ std::vector<LootItem> GameSession::GetLootItems() const {
     return loot_store_.GetAllItems();
 }
 
-Dog* GameSession::SpawnDog(const std::string& dog_name, int id, int bag_capacity) {
-    auto [it, inserted] = dogs_.try_emplace(id, dog_name, id, 
-                                            GenerateDogSpawnCoordinates(), bag_capacity);
-    if (!inserted) {
-        return nullptr;
-    }        
-    return &it->second;
+const LootItem* GameSession::GetLootItem(ItemId id) const {
+    return loot_store_.GetItem(id);
+}
+
+std::optional<DogHandle> GameSession::SpawnDog(const std::string& dog_name, int id, int bag_capacity) {
+    return AddDog(Dog{id, GenerateDogSpawnCoordinates(), bag_capacity}, dog_name);
+}
+
+std::optional<DogHandle> GameSession::AddDog(Dog&& dog, std::string dog_name) {
+    const int id = dog.GetId();
+    if (dog_profiles_.contains(id)) {
+        return std::nullopt;
+    }
+
+    const DogHandle handle = dogs_.Emplace(std::move(dog));
+    dog_profiles_.emplace(id, DogProfile{std::move(dog_name), handle});
+    ++state_version_;
+    RecordChange(StateChangeLog::Kind::DogChanged, id);
+    return handle;
 }
 
 void GameSession::RemoveDog(int id) {
-    dogs_.erase(id);
+    auto it = dog_profiles_.find(id);
+    if (it == dog_profiles_.end()) {
+        return;
+    }
+    dogs_.Erase(it->second.handle);
+    dog_profiles_.erase(it);
+    ++state_version_;
+    RecordChange(StateChangeLog::Kind::DogRemoved, id);
 }
 
 size_t GameSession::GetDogNumber() const {
-    return dogs_.size();
+    return dogs_.Size();
+}
+
+size_t GameSession::GetLootItemNumber() const {
+    return loot_store_.GetItemNumber();
+}
+
+Dog* GameSession::GetDog(DogHandle handle) {
+    return dogs_.Find(handle);
 }
 
-const Dog* GameSession::GetDog(int id) const {
-    auto it = dogs_.find(id);
-    if (it == dogs_.end()) {
-        return nullptr;
+const Dog* GameSession::GetDog(DogHandle handle) const {
+    return dogs_.Find(handle);
+}
+
+std::optional<DogHandle> GameSession::FindDogHandle(int id) const {
+    auto it = dog_profiles_.find(id);
+    if (it == dog_profiles_.end()) {
+        return std::nullopt;
     }
-    return &it->second;
+    return it->second.handle;
 }
 
-const std::unordered_map<int, Dog>& GameSession::GetAllDogs() const {
-    return dogs_;
+const std::string& GameSession::GetDogName(int id) const {
+    return dog_profiles_.at(id).name;
+}
+
+std::span<const Dog> GameSession::GetAllDogs() const {
+    return dogs_.Values();
 }
 
 void GameSession::SetRandomizeSpawnPoints(bool value) {
@@ -260,25 +161,50 @@ void GameSession::MoveDog(Dog& dog, const pos::Direction& dir) {
     }
 
     dog.SetVelocity(v);
+    ++state_version_;
+    RecordChange(StateChangeLog::Kind::DogChanged, dog.GetId());
+}
+
+void GameSession::StopDog(Dog& dog) {
+    dog.SetVelocity(pos::Velocity{0.0, 0.0});
+    ++state_version_;
+    RecordChange(StateChangeLog::Kind::DogChanged, dog.GetId());
+}
+
+std::optional<StateDelta> GameSession::GetChangesSince(uint64_t version) const {
+    if (version > state_version_) {
+        return std::nullopt;
+    }
+    return change_log_.GetChangesSince(version);
+}
+
+uint64_t GameSession::InitialStateVersion() {
+    const auto since_epoch = std::chrono::system_clock::now().time_since_epoch();
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(since_epoch).count());
+}
+
+void GameSession::RecordChange(StateChangeLog::Kind kind, uint32_t id) {
+    change_log_.Record(state_version_, kind, id);
 }
 
 void GameSession::ClearDynamicState() {
-    dogs_.clear();
+    dogs_.Clear();
+    dog_profiles_.clear();
     loot_store_.Clear();
     map_.ClearLootIndex();
+    ++state_version_;
+    change_log_.Reset(state_version_);
 }
 
-Dog* GameSession::RestoreDog(Dog&& dog) {
-    auto [it, inserted] = dogs_.try_emplace(dog.GetId(), std::move(dog));
-    if (!inserted) {
-        return nullptr;
-    }
-    return &it->second;
+std::optional<DogHandle> GameSession::RestoreDog(Dog&& dog, std::string dog_name) {
+    return AddDog(std::move(dog), std::move(dog_name));
 }
 
 void GameSession::RestoreLootItem(ItemId id, const LootInfo info, const pos::Coordinate& coord, double width) {
     loot_store_.RestoreItem(id, info, coord, width);
     map_.AddLootItem(*loot_store_.GetItem(id));
+    ++state_version_;
+    RecordChange(StateChangeLog::Kind::LootAdded, id);
 }
 
 void GameSession::FinalizeAfterRestore() {
@@ -289,7 +215,7 @@ void GameSession::SpawnLoot() {
     auto now = std::chrono::steady_clock::now();
     auto delta = std::chrono::duration_cast<std::chrono::milliseconds>(now - last_loot_spawn_time_);
     size_t loot_count = loot_store_.GetItemNumber();
-    size_t looter_count = dogs_.size();
+    size_t looter_count = dogs_.Size();
 
     unsigned items_to_generate = loot_gen_.Generate(delta, loot_count, looter_count);
 
@@ -300,6 +226,7 @@ void GameSession::SpawnLoot() {
         const LootInfo info = map_.GetLootInfo(type);
         const LootItem& item = loot_store_.Create(info, c);
         map_.AddLootItem(item);
+        RecordChange(StateChangeLog::Kind::LootAdded, item.id);
     }
 
     if (items_to_generate > 0) {
@@ -308,26 +235,36 @@ void GameSession::SpawnLoot() {
 }
 
 // loot event processing
-void GameSession::LootEventProcessing(std::vector<collision::Gatherer> dogs) {
-    std::unordered_set<Map::Cell, Map::CellHasher> checked_cells;
-
-    // find all cells that need to be checked for loot items
-    for (const auto& dog : dogs) {
-        auto cells = map_.GetCellsOnTheWayArea(dog.start_pos, dog.end_pos, dog.width);
-        checked_cells.insert(cells.begin(), cells.end());
+void GameSession::LootEventProcessing(const std::vector<collision::Gatherer>& gatherers) {
+    auto& items = tick_scratch_.items;
+    auto& seen = tick_scratch_.seen_items;
+    items.clear();
+
+    // a new epoch invalidates all marks of the previous tick at once
+    if (++tick_scratch_.epoch == 0) {
+        std::ranges::fill(seen, 0);
+        tick_scratch_.epoch = 1;
     }
+    const uint32_t epoch = tick_scratch_.epoch;
+
+    // gather items in the cells swept by every dog, each item is taken once
+    for (const auto& dog : gatherers) {
+        const auto area = map_.GetCellsOnTheWayArea(dog.start_pos, dog.end_pos, dog.width);
+        map_.ForEachItemInArea(area, [&](ItemId id) {
+            if (id >= seen.size()) {
+                seen.resize(id + 1, 0);
+            }
+            if (seen[id] == epoch) {
+                return;
+            }
+            seen[id] = epoch;
 
-    // gather all items in the checked cells
-    std::vector<collision::Item> items;
-    for (const auto& cell : checked_cells) {
-        auto ids_in_cell = map_.GetItemIdsInCell(cell);
-        for (auto id : ids_in_cell) {
             const LootItem* item = loot_store_.GetItem(id);
             if (!item) {
-                continue;
+                return;
             }
-            items.emplace_back("loot", item->coordinate, item->width, item->id);
-        }
+            items.emplace_back(collision::ItemKind::Loot, item->coordinate, item->width, item->id);
+        });
     }
 
     // add offices to the items list
@@ -336,27 +273,22 @@ void GameSession::LootEventProcessing(std::vector<collision::Gatherer> dogs) {
             static_cast<double>(office.GetPosition().x),
             static_cast<double>(office.GetPosition().y)
         };
-        items.emplace_back("office", office_pos, map_.GetOfficeWidth(), 0);
+        items.emplace_back(collision::ItemKind::Office, office_pos, map_.GetOfficeWidth(), 0);
     }
 
     // find gathering events
-    LootPickupProvider provider(loot_store_, items, dogs);
-    auto events = collision::FindGatherEvents(provider);
+    LootPickupProvider provider(items, gatherers);
+    auto events = collision::FindGatherEventsInGrid(provider);
 
-    // process gathering events
-    std::unordered_set<ItemId> picked;
+    // process gathering events, gatherer ids are positions in the dense dog array
+    auto dogs = dogs_.Values();
+    auto& picked = tick_scratch_.picked;
+    picked.clear();
     for (const auto& event : events) {
-        if (event.item_type == "office") {
+        if (event.item_kind == collision::ItemKind::Office) {
             // скидываем предметы в офис
             // и начисляем очки
-            int dog_id = event.gatherer_id;
-            auto dog_it = dogs_.find(dog_id);
-            
-            if (dog_it == dogs_.end()) {
-                continue;
-            }
-
-            dog_it->second.ClearItems();
+            dogs[event.gatherer_id].ClearItems();
             
             continue;
         }
@@ -373,26 +305,25 @@ void GameSession::LootEventProcessing(std::vector<collision::Gatherer> dogs) {
         }
 
         // give the item to the dog
-        int dog_id = event.gatherer_id;
-        auto dog_it = dogs_.find(dog_id);
-
-        if (dog_it == dogs_.end()) {
-            continue;
-        }
-
-        if (dog_it->second.AddItem(*item)) {
+        if (dogs[event.gatherer_id].AddItem(*item)) {
             // remove the item from the map and loot store
             map_.RemoveLootItem(*item);
             loot_store_.Remove(event.item_id);
+            RecordChange(StateChangeLog::Kind::LootRemoved, item_id);
         }
     }
 }
 
 void GameSession::Tick(std::chrono::milliseconds delta) {
     const double dt = std::chrono::duration<double>(delta).count();
-    std::vector<collision::Gatherer> dogs;
+    ++state_version_;
+
+    auto& gatherers = tick_scratch_.gatherers;
+    gatherers.clear();
 
-    for (auto& [id, dog] : dogs_) {
+    const auto dogs = dogs_.Values();
+    for (size_t index = 0; index < dogs.size(); ++index) {
+        Dog& dog = dogs[index];
         auto pos = dog.GetPosition();
         auto& vel = pos.velocity_;
         auto& coord = pos.coordinates_;
@@ -414,12 +345,13 @@ void GameSession::Tick(std::chrono::milliseconds delta) {
         }
 
         dog.SetCoordinates(restr_pos);
+        RecordChange(StateChangeLog::Kind::DogChanged, dog.GetId());
 
-        dogs.push_back(collision::Gatherer{            
+        gatherers.push_back(collision::Gatherer{            
             .start_pos = coord,
             .end_pos = restr_pos,
             .width = dog.GetPickupRadius(),
-            .id = dog.GetId(),
+            .id = static_cast<int>(index),
         });
 
         // stop on collision with road boundary
@@ -428,7 +360,7 @@ void GameSession::Tick(std::chrono::milliseconds delta) {
         }
     }
 
-    LootEventProcessing(dogs);
+    LootEventProcessing(gatherers);
     SpawnLoot();
 }
 
@@ -490,17 +422,15 @@ pos::Coordinate GameSession::RestrictMovementToRoads(const pos::Coordinate& from
 
     // movement on X-axis
     if (std::abs(dx) >= std::abs(dy)) {
-        auto intervals = BuildIntervalsAlongRoadAxis(map_, from, RoadOrientation::Horizontal);
-
-        const double clamped_x = RestrictInsideIntervals(from.x, to.x, std::move(intervals));
+        const auto interval = map_.FindRoadInterval(from, RoadIntervalIndex::Axis::X);
+        const double clamped_x = RestrictInsideInterval(from.x, to.x, interval);
         return pos::Coordinate{clamped_x, from.y};
     }
 
     // movement on Y-axis
-    auto intervals = BuildIntervalsAlongRoadAxis(map_, from, RoadOrientation::Vertical);
-
-    const double clamped_y = RestrictInsideIntervals(from.y, to.y, std::move(intervals));
-    return pos::Coordinate{from.x, clamped_y};                                                             
+    const auto interval = map_.FindRoadInterval(from, RoadIntervalIndex::Axis::Y);
+    const double clamped_y = RestrictInsideInterval(from.y, to.y, interval);
+    return pos::Coordinate{from.x, clamped_y};
 }
 
 } // namespace model
\ No newline at end of file
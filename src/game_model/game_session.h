@@ -2,8 +2,12 @@
 
 #include <list>
 #include <vector>
+#include <unordered_set>
 #include <optional>
 #include <chrono>
+#include <span>
+#include <string>
+#include <unordered_map>
  
 #include "dog.h"
 #include "map.h"
@@ -12,36 +16,70 @@
 #include "../detail/random_gen.h"
 #include "../detail/position.h"
 #include "collision_detector.h"
+#include "slot_map.h"
+#include "state_change_log.h"
 
 namespace model {
 
+using DogHandle = SlotMap<Dog>::Handle;
+
 // game session binds a map and a set of dogs that exist on this map
 // the session is responsible for spawning, applying player movement commands
 // and advancing simulation by discrete ticks
 class GameSession {
 public:
-    explicit GameSession(Map& map, loot_gen::LootGenerator& lg) 
+    // the session keeps its own copy of the loot generator,
+    // so sessions of different maps can be ticked concurrently
+    explicit GameSession(Map& map, const loot_gen::LootGenerator& lg) 
         : map_{map}
-        , loot_gen_(lg) {
+        , loot_gen_(lg)
+        , state_version_{InitialStateVersion()} {
+        // versions handed out before the session existed, e.g. by the previous run of the server,
+        // are below the floor and get the full state
+        change_log_.Reset(state_version_);
     }
 
     Map& GetMap();
     const Map& GetMap() const;
     const Map::Id& GetMapId() const;
     std::vector<LootItem> GetLootItems() const;
+    // visits the loot in the order of GetLootItems without copying it
+    template <typename Fn>
+    void ForEachLootItem(Fn&& fn) const {
+        loot_store_.ForEachItem(std::forward<Fn>(fn));
+    }
+    const LootItem* GetLootItem(ItemId id) const;
     size_t GetDogNumber() const;
-    const Dog* GetDog(int id) const;
-    const std::unordered_map<int, Dog>& GetAllDogs() const;
+    size_t GetLootItemNumber() const;
+
+    // handles stay valid until the dog is removed, pointers only until the next spawn or removal
+    Dog* GetDog(DogHandle handle);
+    const Dog* GetDog(DogHandle handle) const;
+    std::optional<DogHandle> FindDogHandle(int id) const;
+    const std::string& GetDogName(int id) const;
 
-    Dog* SpawnDog(const std::string& dog_name, int id, int bag_capacity);
+    // dogs are stored contiguously in no particular order
+    std::span<const Dog> GetAllDogs() const;
+
+    std::optional<DogHandle> SpawnDog(const std::string& dog_name, int id, int bag_capacity);
     void RemoveDog(int id);
     void SetRandomizeSpawnPoints(bool value);
 
     // updates dog direction and sets velocity according to the map dog speed
     void MoveDog(Dog& dog, const pos::Direction& dir);
+    void StopDog(Dog& dog);
+
+    // changes whenever dogs or loot of the session change, used to reuse serialized state
+    uint64_t GetStateVersion() const {
+        return state_version_;
+    }
+
+    // ids of dogs and loot changed after the given state version,
+    // nullopt when the version is unknown or too old and a full state is needed
+    std::optional<StateDelta> GetChangesSince(uint64_t version) const;
 
     void ClearDynamicState();
-    Dog* RestoreDog(Dog&& dog);
+    std::optional<DogHandle> RestoreDog(Dog&& dog, std::string dog_name);
     void RestoreLootItem(ItemId id, const LootInfo info, const pos::Coordinate& coord, double width);
     void FinalizeAfterRestore();
 
@@ -54,21 +92,51 @@ private:
     LootType GetRandomLootType() const;
 
     void SpawnLoot();
-    void LootEventProcessing(std::vector<collision_detector::Gatherer> dogs);
+    void LootEventProcessing(const std::vector<collision_detector::Gatherer>& gatherers);
 
     // clamps a movement segment to allowed road surface
     // returns the closest reachable point towards the target coordinate
     pos::Coordinate RestrictMovementToRoads(const pos::Coordinate& from, const pos::Coordinate& to) const;
 
 private:
+    // buffers reused between ticks, so a tick does not allocate once they have grown
+    struct TickScratch {
+        std::vector<collision_detector::Gatherer> gatherers;
+        std::vector<collision_detector::Item> items;
+        // seen_items[id] == epoch marks a loot item already gathered in the current tick
+        std::vector<uint32_t> seen_items;
+        uint32_t epoch = 0;
+        std::unordered_set<ItemId> picked;
+    };
+
+    // rarely used data of a dog, kept out of the dense array
+    struct DogProfile {
+        std::string name;
+        DogHandle handle;
+    };
+
+    std::optional<DogHandle> AddDog(Dog&& dog, std::string dog_name);
+
+    // the current time in microseconds: later runs start above the versions of earlier ones
+    // as long as a run makes less than one change per microsecond, and it stays below 2^53,
+    // so javascript clients read it exactly
+    static uint64_t InitialStateVersion();
+
+    // every change starts a new state version and is recorded under it
+    void RecordChange(StateChangeLog::Kind kind, uint32_t id);
+
     Map& map_;
-    std::unordered_map<int, Dog> dogs_;
+    SlotMap<Dog> dogs_;
+    std::unordered_map<int, DogProfile> dog_profiles_;
     bool randomize_spawn_points_ = false;
 
-    loot_gen::LootGenerator& loot_gen_;
+    loot_gen::LootGenerator loot_gen_;
     LootStore loot_store_;
     std::chrono::steady_clock::time_point last_loot_spawn_time_
                                     = std::chrono::steady_clock::now();
+    TickScratch tick_scratch_;
+    uint64_t state_version_ = 0;
+    StateChangeLog change_log_;
 };
 
 }
\ No newline at end of file
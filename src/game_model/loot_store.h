@@ -95,6 +95,16 @@ public:
         return &opt.value();
     }
 
+    // visits the items in id order without copying them
+    template <typename Fn>
+    void ForEachItem(Fn&& fn) const {
+        for (const auto& item_opt : items_) {
+            if (item_opt.has_value()) {
+                fn(*item_opt);
+            }
+        }
+    }
+
     std::vector<LootItem> GetAllItems() const {
         std::vector<LootItem> res;
         for (auto& item_opt : items_) {
@@ -5,6 +5,29 @@
 
 namespace model {
 
+namespace {
+
+// half width of the road surface around the road axis
+constexpr double kRoadHalfWidth = 0.4;
+
+RoadIntervalIndex::Rect RoadRect(const Road& road) {
+    if (road.IsHorizontal()) {
+        const double y = static_cast<double>(road.GetStart().y);
+        const double x0 = static_cast<double>(road.GetMinAlongAxis()) - kRoadHalfWidth;
+        const double x1 = static_cast<double>(road.GetMaxAlongAxis()) + kRoadHalfWidth;
+
+        return { x0, x1, y - kRoadHalfWidth, y + kRoadHalfWidth };
+    }
+
+    const double x = static_cast<double>(road.GetStart().x);
+    const double y0 = static_cast<double>(road.GetMinAlongAxis()) - kRoadHalfWidth;
+    const double y1 = static_cast<double>(road.GetMaxAlongAxis()) + kRoadHalfWidth;
+
+    return { x - kRoadHalfWidth, x + kRoadHalfWidth, y0, y1 };
+}
+
+} // namespace
+
 bool Road::IsHorizontal() const noexcept {
     return start_.y == end_.y;
 }
@@ -36,89 +59,29 @@ Coord Road::GetMaxAlongAxis() const noexcept {
 }
 
 void Map::AddRoad(const Road& road) {
-    const size_t index = roads_.size();
     roads_.emplace_back(road);
-    IndexingRoadInCells(index);
 }
 
 void Map::AddBuilding(const Building& building) {
     buildings_.emplace_back(building);
 }
 
-void Map::RebuildRoadCellIndex() {
-    roads_by_cell_.clear();
-    roads_by_cell_.reserve(roads_.size() * 2);
-
-    for (size_t i = 0; i < roads_.size(); ++i) {
-        IndexingRoadInCells(i);
+void Map::RebuildRoadIntervalIndex() {
+    std::vector<RoadIntervalIndex::Rect> corridors;
+    corridors.reserve(roads_.size());
+    for (const auto& road : roads_) {
+        corridors.push_back(RoadRect(road));
     }
+    intervals_along_x_ = RoadIntervalIndex{corridors, RoadIntervalIndex::Axis::X};
+    intervals_along_y_ = RoadIntervalIndex{corridors, RoadIntervalIndex::Axis::Y};
 }
 
-void Map::IndexingRoadInCells(size_t road_index) {
-    const Road& r = roads_.at(road_index);
-    const auto& a = r.GetStart();
-    const auto& b = r.GetEnd();
-
-    if (r.IsHorizontal()) {
-        const int y = a.y;
-        const int x0 = std::min(a.x, b.x);
-        const int x1 = std::max(a.x, b.x);
-
-        // index all cells along the horizontal axis line
-        for (int x = x0; x <= x1; ++x) {
-            roads_by_cell_[Cell{x, y}].push_back(road_index);
-        }
-
-        // touch adjacent rows to reduce misses near the road width boundary
-        roads_by_cell_[Cell{x0, y - 1}];
-        roads_by_cell_[Cell{x0, y + 1}];
-        return;
+std::optional<RoadIntervalIndex::Interval> Map::FindRoadInterval(const pos::Coordinate& c,
+                                                                 RoadIntervalIndex::Axis axis) const {
+    if (axis == RoadIntervalIndex::Axis::X) {
+        return intervals_along_x_.Find(c.y, c.x);
     }
-
-    const int x = a.x;
-    const int y0 = std::min(a.y, b.y);
-    const int y1 = std::max(a.y, b.y);
-
-    // index all cells along the vertical axis line
-    for (int y = y0; y <= y1; ++y) {
-        roads_by_cell_[Cell{x, y}].push_back(road_index);
-    }
-}
-
-// gathers candidate roads using the cell index
-// neighbor cells are used to avoid missing roads when the point is close to cell borders
-std::vector<size_t> Map::GetRoadCandidates(const pos::Coordinate& c) const {
-    const int cx = static_cast<int>(std::floor(c.x));
-    const int cy = static_cast<int>(std::floor(c.y));
-
-    size_t reserve_hint = 8;
-    std::vector<size_t> result;
-    result.reserve(reserve_hint);
-
-    auto add_from_cell = [&](int x, int y) {
-        auto it = roads_by_cell_.find(Cell{x, y});
-        if (it == roads_by_cell_.end()) {
-            return;
-        }
-        const auto& vec = it->second;
-        result.insert(result.end(), vec.begin(), vec.end());
-    };
-
-    // base cell and immediate neighbors
-    // this covers most cases where the road rectangle intersects the query line
-    add_from_cell(cx, cy);
-    add_from_cell(cx + 1, cy);
-    add_from_cell(cx, cy + 1);
-    add_from_cell(cx + 1, cy + 1);
-
-    // additional cases
-    add_from_cell(cx - 1, cy);
-    add_from_cell(cx, cy - 1);
-
-    std::sort(result.begin(), result.end());
-    result.erase(std::unique(result.begin(), result.end()), result.end());
-
-    return result;
+    return intervals_along_y_.Find(c.x, c.y);
 }
 
 void Map::AddLootType(const std::string& type, int value) {
@@ -134,18 +97,35 @@ void Map::AddLootType(const std::string& type, int value) {
 }
 
 void Map::AddLootItem(const LootItem& item) {
-    const int cx = static_cast<int>(std::floor(item.coordinate.x));
-    const int cy = static_cast<int>(std::floor(item.coordinate.y));
-    items_by_cell_[Cell{cx, cy}].insert(item.id);
+    auto& ids = items_by_cell_[CellOf(item.coordinate)];
+    if (item.id >= item_slots_.size()) {
+        item_slots_.resize(item.id + 1, kNoSlot);
+    }
+    item_slots_[item.id] = static_cast<uint32_t>(ids.size());
+    ids.push_back(item.id);
 }
 
 void Map::RemoveLootItem(const LootItem& item) {
-    const int cx = static_cast<int>(std::floor(item.coordinate.x));
-    const int cy = static_cast<int>(std::floor(item.coordinate.y));
-    auto it = items_by_cell_.find(Cell{cx, cy});
-    if (it != items_by_cell_.end()) {
-        it->second.erase(item.id);
+    if (item.id >= item_slots_.size() || item_slots_[item.id] == kNoSlot) {
+        return;
     }
+    auto it = items_by_cell_.find(CellOf(item.coordinate));
+    if (it == items_by_cell_.end()) {
+        return;
+    }
+
+    // move the last id of the cell into the freed slot
+    auto& ids = it->second;
+    const uint32_t slot = item_slots_[item.id];
+    ids[slot] = ids.back();
+    item_slots_[ids[slot]] = slot;
+    ids.pop_back();
+    item_slots_[item.id] = kNoSlot;
+}
+
+void Map::ClearLootIndex() {
+    items_by_cell_.clear();
+    item_slots_.clear();
 }
 
 const Map::Id& Map::GetId() const noexcept {
@@ -205,17 +185,16 @@ const std::vector<LootType> Map::GetAllLootTypes() const {
     return types;
 }
 
-std::vector<ItemId> Map::GetItemIdsInCell(const Cell& cell) const {
-    std::vector<ItemId> result;
+std::span<const ItemId> Map::GetItemIdsInCell(const Cell& cell) const {
     auto it = items_by_cell_.find(cell);
-    if (it != items_by_cell_.end()) {
-        result.insert(result.end(), it->second.begin(), it->second.end());
+    if (it == items_by_cell_.end()) {
+        return {};
     }
-    return result;
+    return {it->second.data(), it->second.size()};
 }
 
-std::vector<Map::Cell> Map::GetCellsOnTheWayArea(const pos::Coordinate& from, const pos::Coordinate& to, 
-                                                 double width_area) const {
+Map::CellArea Map::GetCellsOnTheWayArea(const pos::Coordinate& from, const pos::Coordinate& to, 
+                                        double width_area) const {
     const int min_x = static_cast<int>(std::floor(
         std::min(from.x, to.x) - width_area
     ));
@@ -229,16 +208,7 @@ std::vector<Map::Cell> Map::GetCellsOnTheWayArea(const pos::Coordinate& from, co
         std::max(from.y, to.y) + width_area
     ));
 
-    std::vector<Cell> result;
-    result.reserve((max_x - min_x + 1) * (max_y - min_y + 1));
-
-    for (int x = min_x; x <= max_x; ++x) {
-        for (int y = min_y; y <= max_y; ++y) {
-            result.push_back(Cell{x, y});
-        }
-    }
-
-    return result;
+    return CellArea{Cell{min_x, min_y}, Cell{max_x, max_y}};
 }
 
 } // namespace model
\ No newline at end of file
@@ -2,10 +2,15 @@
 #include <string>
 #include <unordered_map>
 #include <vector>
-#include <set>
+#include <cmath>
 #include <cstdint>
+#include <optional>
+#include <span>
+
+#include <boost/container/small_vector.hpp>
 
 #include "loot_struct.h"
+#include "road_intervals.h"
 #include "../detail/tagged.h"
 #include "../detail/position.h"
 
@@ -123,7 +128,7 @@ public:
         , name_(std::move(name)) {
     }
 
-    // integer grid cell used for road spatial index
+    // integer grid cell, the key of the loot item index
     struct Cell {
         int x = 0;
         int y = 0;
@@ -142,6 +147,12 @@ public:
         }
     };
 
+    // inclusive rectangle of cells
+    struct CellArea {
+        Cell min;
+        Cell max;
+    };
+
     const Id& GetId() const noexcept;
     const std::string& GetName() const noexcept;
     const Buildings& GetBuildings() const noexcept;
@@ -154,18 +165,50 @@ public:
     LootType GetLootType(size_t index) const;
     LootInfo GetLootInfo(LootType const type) const;
     const std::vector<LootType> GetAllLootTypes() const;
-    std::vector<ItemId> GetItemIdsInCell(const Cell& cell) const;
-    std::vector<Cell> GetCellsOnTheWayArea(const pos::Coordinate& from, const pos::Coordinate& to, 
-                                            double width_area) const;
+    // ids of loot items lying in the cell, valid until the loot index changes
+    std::span<const ItemId> GetItemIdsInCell(const Cell& cell) const;
+
+    // calls fn(item_id) for every loot item in the rectangle of cells
+    template <typename Fn>
+    void ForEachItemInArea(const CellArea& area_cells, Fn&& fn) const {
+        const Cell& min = area_cells.min;
+        const Cell& max = area_cells.max;
+        const uint64_t area = static_cast<uint64_t>(max.x - min.x + 1) * static_cast<uint64_t>(max.y - min.y + 1);
+
+        // a large rectangle is cheaper to check against every occupied cell
+        if (area > items_by_cell_.size()) {
+            for (const auto& [cell, ids] : items_by_cell_) {
+                if (cell.x >= min.x && cell.x <= max.x && cell.y >= min.y && cell.y <= max.y) {
+                    for (ItemId id : ids) {
+                        fn(id);
+                    }
+                }
+            }
+            return;
+        }
+
+        for (int x = min.x; x <= max.x; ++x) {
+            for (int y = min.y; y <= max.y; ++y) {
+                for (ItemId id : GetItemIdsInCell(Cell{x, y})) {
+                    fn(id);
+                }
+            }
+        }
+    }
+
+    // cells covered by the bounding box of the movement widened by width_area
+    CellArea GetCellsOnTheWayArea(const pos::Coordinate& from, const pos::Coordinate& to, 
+                                  double width_area) const;
 
-    // returns road indices that may contain the given coordinate
-    // the result is used to avoid linear scan over all roads
-    std::vector<size_t> GetRoadCandidates(const pos::Coordinate& c) const;
+    // returns the merged road corridor interval along the axis that contains the coordinate
+    // the interval joins all roads covering the coordinate on the cross axis
+    std::optional<RoadIntervalIndex::Interval> FindRoadInterval(const pos::Coordinate& c,
+                                                                RoadIntervalIndex::Axis axis) const;
 
-    // rebuilds the cell index after bulk road loading
-    void RebuildRoadCellIndex();
+    // rebuilds the road interval indices after bulk road loading
+    void RebuildRoadIntervalIndex();
 
-    // adds a road and updates the cell index
+    // adds a road, the road interval indices are updated by RebuildRoadIntervalIndex
     void AddRoad(const Road& road);
     void AddBuilding(const Building& building);
     void AddOffice(Office office);
@@ -174,17 +217,16 @@ public:
 
     void RemoveLootItem(const LootItem& item);
 
-    void ClearLootIndex() {
-        items_by_cell_.clear();
-    }
+    void ClearLootIndex();
 
     void SetDogSpeed(double speed) {
         dog_speed_ = speed;
     }
 
 private:
-    // puts the road into all grid cells covered by its axis line
-    void IndexingRoadInCells(size_t road_index);
+    static Cell CellOf(const pos::Coordinate& c) noexcept {
+        return Cell{static_cast<int>(std::floor(c.x)), static_cast<int>(std::floor(c.y))};
+    }
 
 private:
     using OfficeIdToIndex = std::unordered_map<Office::Id, size_t, util::TaggedHasher<Office::Id>>;
@@ -198,10 +240,14 @@ private:
     OfficeIdToIndex warehouse_id_to_index_;
     Offices offices_;
 
-    // spatial index for fast lookup of nearby roads
-    std::unordered_map<Cell, std::vector<size_t>, CellHasher> roads_by_cell_;
+    // merged road corridors for movement along x and along y
+    RoadIntervalIndex intervals_along_x_;
+    RoadIntervalIndex intervals_along_y_;
     // spatial index for fast lookup of nearby items (contains item IDs)
-    std::unordered_map<Cell, std::set<size_t>, CellHasher> items_by_cell_;
+    // ids of a cell are unordered, item_slots_[id] is the position of the id inside its cell
+    static constexpr uint32_t kNoSlot = UINT32_MAX;
+    std::unordered_map<Cell, boost::container::small_vector<ItemId, 4>, CellHasher> items_by_cell_;
+    std::vector<uint32_t> item_slots_;
 
     // constants
     double dog_speed_ = 1.0;
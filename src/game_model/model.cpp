@@ -1,10 +1,34 @@
 #include "model.h"
 
+#include <exception>
+#include <latch>
+#include <mutex>
 #include <stdexcept>
 
+#include <boost/asio/post.hpp>
+#include <boost/asio/thread_pool.hpp>
+
 namespace model {
 using namespace std::literals;
 
+struct Game::TickWorkers {
+    explicit TickWorkers(unsigned threads)
+        : pool{threads} {
+    }
+
+    ~TickWorkers() {
+        pool.join();
+    }
+
+    boost::asio::thread_pool pool;
+};
+
+Game::Game(loot_gen::LootGenerator&& loot_gen) 
+    : loot_gen_(std::move(loot_gen)) {
+}
+
+Game::~Game() = default;
+
 void Map::AddOffice(Office office) {
     if (warehouse_id_to_index_.contains(office.GetId())) {
         throw std::invalid_argument("Duplicate warehouse");
@@ -74,9 +98,46 @@ void Game::SetRandomizeSpawnPoints(bool value) {
     }
 }
 
+void Game::SetTickThreads(unsigned threads) {
+    if (threads > 1) {
+        tick_workers_ = std::make_unique<TickWorkers>(threads);
+    }
+    else {
+        tick_workers_.reset();
+    }
+}
+
 void Game::Tick(std::chrono::milliseconds delta) {
+    if (!tick_workers_ || sessions_.size() < 2) {
+        for (auto& session : sessions_) {
+            session.Tick(delta);
+        }
+        return;
+    }
+
+    // sessions do not share any state, so each one is ticked as a separate task
+    // the latch is the tick barrier: the caller continues after the last session
+    std::latch done{static_cast<std::ptrdiff_t>(sessions_.size())};
+    std::mutex error_mutex;
+    std::exception_ptr error;
+
     for (auto& session : sessions_) {
-        session.Tick(delta);
+        boost::asio::post(tick_workers_->pool, [&session, &done, &error_mutex, &error, delta] {
+            try {
+                session.Tick(delta);
+            } catch (...) {
+                std::lock_guard lock{error_mutex};
+                if (!error) {
+                    error = std::current_exception();
+                }
+            }
+            done.count_down();
+        });
+    }
+
+    done.wait();
+    if (error) {
+        std::rethrow_exception(error);
     }
 }
 
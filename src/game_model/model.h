@@ -4,6 +4,7 @@
 #include <deque>
 #include <unordered_map>
 #include <chrono>
+#include <memory>
 
 #include "game_session.h"
 #include "map.h"
@@ -15,9 +16,8 @@ class Game {
 public:
     using Maps = std::deque<Map>;
 
-    Game(loot_gen::LootGenerator&& loot_gen) 
-            : loot_gen_(std::move(loot_gen)) {
-    }
+    Game(loot_gen::LootGenerator&& loot_gen);
+    ~Game();
  
     void AddMap(Map map);    
 
@@ -28,6 +28,10 @@ public:
 
     void SetRandomizeSpawnPoints(bool value);
 
+    // with more than one thread sessions are ticked concurrently on a worker pool,
+    // Tick returns only after every session has been advanced
+    void SetTickThreads(unsigned threads);
+
     const Map* FindMap(const Map::Id& id) const noexcept;
     void BuildSessions();
     void Tick(std::chrono::milliseconds delta);
@@ -38,6 +42,9 @@ private:
     }
 
 private:
+    // worker pool used for parallel ticks, defined in model.cpp
+    struct TickWorkers;
+
     using MapIdHasher = util::TaggedHasher<Map::Id>;
     using MapIdToIndex = std::unordered_map<Map::Id, size_t, MapIdHasher>;
 
@@ -47,6 +54,7 @@ private:
     std::vector<GameSession> sessions_;
     loot_gen::LootGenerator loot_gen_;
     bool randomize_spawn_points_ = false;
+    std::unique_ptr<TickWorkers> tick_workers_;
 };
 
 }  // namespace model
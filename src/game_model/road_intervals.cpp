@@ -0,0 +1,117 @@
+#include "road_intervals.h"
+
+#include <algorithm>
+
+namespace model {
+
+namespace {
+
+constexpr double kEps = 1e-6;
+
+} // namespace
+
+RoadIntervalIndex::RoadIntervalIndex(const std::vector<Rect>& corridors, Axis axis) {
+    struct Span {
+        double across_from;
+        double across_to;
+        Interval along;
+    };
+
+    std::vector<Span> spans;
+    spans.reserve(corridors.size());
+    for (const auto& r : corridors) {
+        if (axis == Axis::X) {
+            spans.push_back({r.min_y - kEps, r.max_y + kEps, {r.min_x, r.max_x}});
+        } else {
+            spans.push_back({r.min_x - kEps, r.max_x + kEps, {r.min_y, r.max_y}});
+        }
+    }
+
+    for (const auto& s : spans) {
+        boundaries_.push_back(s.across_from);
+        boundaries_.push_back(s.across_to);
+    }
+    std::ranges::sort(boundaries_);
+    boundaries_.erase(std::unique(boundaries_.begin(), boundaries_.end()), boundaries_.end());
+
+    // a corridor covers the contiguous range of regions from its first to its last boundary point
+    const size_t region_count = boundaries_.size() * 2 + 1;
+    std::vector<int64_t> deltas(region_count + 1, 0);
+    std::vector<std::pair<size_t, size_t>> covered;
+    covered.reserve(spans.size());
+    for (const auto& s : spans) {
+        const size_t first = FindRegion(s.across_from);
+        const size_t last = FindRegion(s.across_to);
+        covered.emplace_back(first, last);
+        ++deltas[first];
+        --deltas[last + 1];
+    }
+
+    offsets_.assign(region_count + 1, 0);
+    int64_t active = 0;
+    for (size_t r = 0; r < region_count; ++r) {
+        active += deltas[r];
+        offsets_[r + 1] = offsets_[r] + static_cast<uint32_t>(active);
+    }
+
+    intervals_.resize(offsets_.back());
+    std::vector<uint32_t> fill(offsets_.begin(), offsets_.end() - 1);
+    for (size_t i = 0; i < spans.size(); ++i) {
+        for (size_t r = covered[i].first; r <= covered[i].second; ++r) {
+            intervals_[fill[r]++] = spans[i].along;
+        }
+    }
+
+    // sort and merge every region in place, then compact the storage
+    uint32_t out = 0;
+    for (size_t r = 0; r < region_count; ++r) {
+        const auto begin = intervals_.begin() + offsets_[r];
+        const auto end = intervals_.begin() + offsets_[r + 1];
+        std::sort(begin, end, [](const Interval& a, const Interval& b) {
+            return a.left < b.left;
+        });
+
+        const uint32_t region_begin = out;
+        for (auto it = begin; it != end; ++it) {
+            if (out == region_begin || it->left > intervals_[out - 1].right) {
+                intervals_[out++] = *it;
+            } else {
+                intervals_[out - 1].right = std::max(intervals_[out - 1].right, it->right);
+            }
+        }
+        offsets_[r] = region_begin;
+    }
+    offsets_.back() = out;
+    intervals_.resize(out);
+    intervals_.shrink_to_fit();
+}
+
+size_t RoadIntervalIndex::FindRegion(double across) const {
+    const auto it = std::ranges::lower_bound(boundaries_, across);
+    const size_t k = static_cast<size_t>(it - boundaries_.begin());
+    if (it != boundaries_.end() && *it == across) {
+        return 2 * k + 1;
+    }
+    return 2 * k;
+}
+
+std::optional<RoadIntervalIndex::Interval> RoadIntervalIndex::Find(double across, double along) const {
+    if (offsets_.empty()) {
+        return std::nullopt;
+    }
+
+    const size_t region = FindRegion(across);
+    const auto begin = intervals_.begin() + offsets_[region];
+    const auto end = intervals_.begin() + offsets_[region + 1];
+
+    // merged intervals are disjoint and sorted, the first one not left of `along` is the only candidate
+    const auto it = std::partition_point(begin, end, [along](const Interval& seg) {
+        return seg.right + kEps < along;
+    });
+    if (it == end || along < it->left - kEps) {
+        return std::nullopt;
+    }
+    return *it;
+}
+
+} // namespace model
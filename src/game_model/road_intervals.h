@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace model {
+
+// precomputed road corridor intervals for movement along one axis
+// the cross axis is split into regions where the set of covering corridors does not change,
+// each region stores its merged intervals sorted, so a lookup is two binary searches
+class RoadIntervalIndex {
+public:
+    enum class Axis {
+        X,
+        Y
+    };
+
+    // axis-aligned rectangle of a road corridor
+    struct Rect {
+        double min_x;
+        double max_x;
+        double min_y;
+        double max_y;
+    };
+
+    // 1d interval of allowed movement along the axis
+    struct Interval {
+        double left;
+        double right;
+    };
+
+    RoadIntervalIndex() = default;
+    RoadIntervalIndex(const std::vector<Rect>& corridors, Axis axis);
+
+    // returns the merged interval containing `along` among corridors that cover `across`
+    // both checks use a small tolerance
+    std::optional<Interval> Find(double across, double along) const;
+
+private:
+    size_t FindRegion(double across) const;
+
+    // region 2k + 1 is the boundary point k, region 2k lies between points k - 1 and k
+    std::vector<double> boundaries_;
+    // intervals of region r are intervals_[offsets_[r], offsets_[r + 1])
+    std::vector<uint32_t> offsets_;
+    std::vector<Interval> intervals_;
+};
+
+} // namespace model
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace model {
+
+// stable reference to an element of a SlotMap
+struct SlotHandle {
+    uint32_t index = std::numeric_limits<uint32_t>::max();
+    uint32_t generation = 0;
+
+    bool operator==(const SlotHandle&) const = default;
+};
+
+// values are kept in one contiguous array, erase moves the last value into the hole
+// handles survive moves of other values, a handle of an erased value is detected
+// by the generation of its slot; pointers to values are invalidated by Emplace and Erase
+template <typename T>
+class SlotMap {
+public:
+    using Handle = SlotHandle;
+
+    template <typename... Args>
+    Handle Emplace(Args&&... args) {
+        uint32_t index;
+        if (!free_slots_.empty()) {
+            index = free_slots_.back();
+            free_slots_.pop_back();
+        } else {
+            index = static_cast<uint32_t>(slots_.size());
+            slots_.emplace_back();
+        }
+
+        values_.emplace_back(std::forward<Args>(args)...);
+        value_slots_.push_back(index);
+
+        Slot& slot = slots_[index];
+        slot.value_index = static_cast<uint32_t>(values_.size() - 1);
+        return Handle{index, slot.generation};
+    }
+
+    bool Erase(Handle handle) {
+        Slot* slot = FindSlot(handle);
+        if (!slot) {
+            return false;
+        }
+
+        const uint32_t hole = slot->value_index;
+        const uint32_t last = static_cast<uint32_t>(values_.size() - 1);
+        if (hole != last) {
+            values_[hole] = std::move(values_[last]);
+            value_slots_[hole] = value_slots_[last];
+            slots_[value_slots_[hole]].value_index = hole;
+        }
+        values_.pop_back();
+        value_slots_.pop_back();
+
+        slot->value_index = kEmpty;
+        ++slot->generation;
+        free_slots_.push_back(handle.index);
+        return true;
+    }
+
+    // invalidates every handle
+    void Clear() {
+        for (uint32_t index : value_slots_) {
+            slots_[index].value_index = kEmpty;
+            ++slots_[index].generation;
+            free_slots_.push_back(index);
+        }
+        values_.clear();
+        value_slots_.clear();
+    }
+
+    T* Find(Handle handle) {
+        const Slot* slot = FindSlot(handle);
+        return slot ? &values_[slot->value_index] : nullptr;
+    }
+
+    const T* Find(Handle handle) const {
+        const Slot* slot = FindSlot(handle);
+        return slot ? &values_[slot->value_index] : nullptr;
+    }
+
+    // handle of the value at the given position of Values()
+    Handle GetHandle(size_t value_index) const {
+        const uint32_t index = value_slots_[value_index];
+        return Handle{index, slots_[index].generation};
+    }
+
+    std::span<T> Values() {
+        return values_;
+    }
+
+    std::span<const T> Values() const {
+        return values_;
+    }
+
+    size_t Size() const {
+        return values_.size();
+    }
+
+private:
+    static constexpr uint32_t kEmpty = std::numeric_limits<uint32_t>::max();
+
+    struct Slot {
+        uint32_t value_index = kEmpty;
+        uint32_t generation = 0;
+    };
+
+    Slot* FindSlot(Handle handle) {
+        return const_cast<Slot*>(std::as_const(*this).FindSlot(handle));
+    }
+
+    const Slot* FindSlot(Handle handle) const {
+        if (handle.index >= slots_.size()) {
+            return nullptr;
+        }
+        const Slot& slot = slots_[handle.index];
+        if (slot.generation != handle.generation || slot.value_index == kEmpty) {
+            return nullptr;
+        }
+        return &slot;
+    }
+
+    std::vector<T> values_;
+    // value_slots_[i] is the slot that refers to values_[i]
+    std::vector<uint32_t> value_slots_;
+    std::vector<Slot> slots_;
+    std::vector<uint32_t> free_slots_;
+};
+
+} // namespace model
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <unordered_set>
+#include <vector>
+
+namespace model {
+
+// ids of entities changed after some state version
+struct StateDelta {
+    std::vector<uint32_t> changed_dogs;
+    std::vector<uint32_t> removed_dogs;
+    std::vector<uint32_t> added_loot;
+    std::vector<uint32_t> removed_loot;
+};
+
+// bounded log of session changes, each record is tagged with the state version it produced
+// changes older than the floor version are dropped, deltas from before the floor are not available
+class StateChangeLog {
+public:
+    enum class Kind : uint8_t {
+        DogChanged,
+        DogRemoved,
+        LootAdded,
+        LootRemoved
+    };
+
+    explicit StateChangeLog(size_t capacity = 1 << 16)
+        : capacity_{capacity} {
+    }
+
+    void Record(uint64_t version, Kind kind, uint32_t id) {
+        if (records_.size() == capacity_) {
+            floor_ = std::max(floor_, records_.front().version);
+            records_.pop_front();
+        }
+        records_.push_back({version, kind, id});
+    }
+
+    // forgets every change up to the version, used when the whole state is replaced
+    void Reset(uint64_t version) {
+        records_.clear();
+        floor_ = version;
+    }
+
+    // changes made after the version, or nullopt when part of them was already dropped
+    // removals are listed even if the entity was added again, clients apply them first
+    std::optional<StateDelta> GetChangesSince(uint64_t version) const {
+        if (version < floor_) {
+            return std::nullopt;
+        }
+
+        std::unordered_set<uint32_t> changed_dogs;
+        std::unordered_set<uint32_t> removed_dogs;
+        std::unordered_set<uint32_t> added_loot;
+        std::unordered_set<uint32_t> removed_loot;
+
+        // records are ordered by version, only the tail is newer than the client
+        auto it = std::ranges::upper_bound(records_, version, {}, &Entry::version);
+        for (; it != records_.end(); ++it) {
+            switch (it->kind) {
+                case Kind::DogChanged:
+                    changed_dogs.insert(it->id);
+                    break;
+                case Kind::DogRemoved:
+                    changed_dogs.erase(it->id);
+                    removed_dogs.insert(it->id);
+                    break;
+                case Kind::LootAdded:
+                    added_loot.insert(it->id);
+                    break;
+                case Kind::LootRemoved:
+                    added_loot.erase(it->id);
+                    removed_loot.insert(it->id);
+                    break;
+            }
+        }
+
+        StateDelta delta;
+        delta.changed_dogs = ToSortedVector(changed_dogs);
+        delta.removed_dogs = ToSortedVector(removed_dogs);
+        delta.added_loot = ToSortedVector(added_loot);
+        delta.removed_loot = ToSortedVector(removed_loot);
+        return delta;
+    }
+
+private:
+    struct Entry {
+        uint64_t version;
+        Kind kind;
+        uint32_t id;
+    };
+
+    static std::vector<uint32_t> ToSortedVector(const std::unordered_set<uint32_t>& ids) {
+        std::vector<uint32_t> result(ids.begin(), ids.end());
+        std::ranges::sort(result);
+        return result;
+    }
+
+    size_t capacity_;
+    uint64_t floor_ = 0;
+    std::deque<Entry> records_;
+};
+
+} // namespace model
@@ -2,11 +2,14 @@
 
 #include <boost/asio/io_context.hpp>
 #include <boost/asio/signal_set.hpp>
+#include <boost/asio/post.hpp>
 #include <iostream>
 #include <algorithm>
+#include <atomic>
 #include <thread>
 
 #include "server/ticker.h"
+#include "server/map_strands.h"
 #include "configuration/json_loader.h"
 #include "configuration/server_configuration.h"
 #include "infrastructure/serializing_listener.h"
@@ -33,6 +36,49 @@ void RunWorkers(unsigned n, const Fn& fn) {
     fn();
 }
 
+// an exception in a tick is logged, the next tick tries again
+void ReportTickError(std::string_view where) {
+    try {
+        throw;
+    } catch (const std::exception& ex) {
+        logger::LogError(ex.what(), where);
+    } catch (...) {
+        logger::LogError("unknown exception", where);
+    }
+}
+
+// Запускает тик каждой карты на её strand. Когда последняя карта обработана,
+// завершение тика выполняется на общем strand
+void TickMapsOnStrands(application::Application& application, const server::MapStrands& strands, 
+                       std::chrono::milliseconds delta) {
+    auto pending = std::make_shared<std::atomic<size_t>>(strands.GetMapCount());
+    if (*pending == 0) {
+        application.FinishTick(delta);
+        return;
+    }
+
+    strands.ForEachMap([&application, &strands, pending, delta](const model::Map::Id& map_id, 
+                                                                const server::MapStrands::Strand& strand) {
+        net::post(strand, [&application, &strands, pending, delta, map_id] {
+            try {
+                application.TickMap(map_id, delta);
+            } catch (...) {
+                ReportTickError("tick map " + *map_id);
+            }
+
+            if (pending->fetch_sub(1) == 1) {
+                net::post(strands.GetCommonStrand(), [&application, delta] {
+                    try {
+                        application.FinishTick(delta);
+                    } catch (...) {
+                        ReportTickError("finish tick");
+                    }
+                });
+            }
+        });
+    });
+}
+
 }  // namespace
 
 int main(int argc, const char* argv[]) {
@@ -49,6 +95,9 @@ int main(int argc, const char* argv[]) {
         json_loader::GameSettings game_settings = json_loader::LoadGame(args.config_file, loot_meta);
         model::Game* game = game_settings.game.get();
         game->SetRandomizeSpawnPoints(args.randomize_spawn_points);
+        if (args.tick_threads.has_value()) {
+            game->SetTickThreads(*args.tick_threads);
+        }
 
         const char* db_url = std::getenv("GAME_DB_URL");
         if (!db_url) {
@@ -64,8 +113,9 @@ int main(int argc, const char* argv[]) {
         // Инициализируем io_context
         net::io_context ioc(num_threads);
 
-        // strand для выполнения запросов к API
-        auto api_strand = net::make_strand(ioc);
+        // strand'ы для выполнения запросов к API: по одному на карту и общий
+        server::MapStrands strands{ioc, game->GetMaps()};
+        auto api_strand = strands.GetCommonStrand();
 
         std::unique_ptr<infrastructure::ServerState> server_state;
         std::unique_ptr<infrastructure::SerializingListener> serializing_listener;
@@ -114,11 +164,24 @@ int main(int argc, const char* argv[]) {
         
         const bool auto_tick_enabled = args.tick_period_ms.has_value();
         if (auto_tick_enabled) {
+            // --tick-threads включает тик всех карт сразу с барьером, даже 0 и 1:
+            // тогда карты тикают по очереди в потоке тика;
+            // иначе каждая карта тикает на своём strand
+            const bool barrier_tick = args.tick_threads.has_value();
             auto ticker = std::make_shared<server::Ticker>(
                         api_strand, 
                         std::chrono::milliseconds(*args.tick_period_ms),
-                        [&application](std::chrono::milliseconds delta) { 
-                            application.Tick(delta); 
+                        [&application, &strands, barrier_tick](std::chrono::milliseconds delta) { 
+                            if (barrier_tick) {
+                                try {
+                                    application.Tick(delta);
+                                } catch (...) {
+                                    ReportTickError("tick");
+                                }
+                            }
+                            else {
+                                TickMapsOnStrands(application, strands, delta); 
+                            }
                         }
             );
             ticker->Start();
@@ -128,16 +191,25 @@ int main(int argc, const char* argv[]) {
         auto handler = std::make_shared<http_handler::RequestHandler>(application, 
                                                                     loot_meta, 
                                                                     args.www_root, 
-                                                                    api_strand, 
+                                                                    strands, 
                                                                     auto_tick_enabled);
 
 
+        // after each tick the state of the map is pushed to its websocket subscribers
+        application.SetOnMapTickCallback([&handler](const model::Map::Id& map_id) {
+            handler->PublishState(map_id);
+        });
+
         // Запустить обработчик HTTP-запросов, делегируя их обработчику запросов
         const auto address = net::ip::make_address("0.0.0.0");
         constexpr net::ip::port_type port = 8080;
-        http_server::ServeHttp(ioc, {address, port}, [&handler](auto&& req, auto&& send) {
-            (*handler)(std::forward<decltype(req)>(req), std::forward<decltype(send)>(send));
-        });
+        http_server::ServeHttp(ioc, {address, port}, 
+            [&handler](auto&& req, auto& auth, auto&& send) {
+                (*handler)(std::forward<decltype(req)>(req), auth, std::forward<decltype(send)>(send));
+            },
+            [&handler](auto& req, auto& stream) {
+                return handler->Upgrade(req, stream);
+            });
 
         // Эта надпись сообщает тестам о том, что сервер запущен и готов обрабатывать запросы        
         logger::LogServerStart(port, address.to_string());
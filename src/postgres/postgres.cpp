@@ -17,9 +17,15 @@ constexpr const char* kCreateTable = R"(
     );
 )";
 
+// names are ordered bytewise, like the in-memory leaderboard, whatever the collation of the database;
+// the index of the former order, with the default collation, is replaced
+constexpr const char* kDropOldIndex = R"(
+    DROP INDEX IF EXISTS retired_players_sort_idx;
+)";
+
 constexpr const char* kCreateIndex = R"(
-    CREATE INDEX IF NOT EXISTS retired_players_sort_idx
-    ON retired_players (score DESC, play_time ASC, name ASC);
+    CREATE INDEX IF NOT EXISTS retired_players_order_idx
+    ON retired_players (score DESC, play_time ASC, name COLLATE "C" ASC);
 )";
 
 int EnsureSchema(const std::string& db_url) {
@@ -27,15 +33,58 @@ int EnsureSchema(const std::string& db_url) {
     pqxx::work tr{conn};
 
     tr.exec(kCreateTable);
+    tr.exec(kDropOldIndex);
     tr.exec(kCreateIndex);
     tr.commit();
     return 0;
 }
 
+// errors caused by the data rather than by the connection are reported as rejected records
+template <typename Fn>
+void RejectInvalidRecords(Fn&& fn) {
+    try {
+        fn();
+    }
+    catch (const pqxx::data_exception& ex) {
+        throw application::RecordsRejectedError{ex.what()};
+    }
+    catch (const pqxx::integrity_constraint_violation& ex) {
+        throw application::RecordsRejectedError{ex.what()};
+    }
+    catch (const pqxx::conversion_error& ex) {
+        throw application::RecordsRejectedError{ex.what()};
+    }
+}
+
 }  // namespace
 
 void RecordsRepositoryImpl::AddRecord(const application::PlayerRecord& record) {
-    tr_.exec_prepared("insert_retired_player", record.name, record.score, record.play_time);
+    RejectInvalidRecords([&] {
+        tr_.exec_prepared("insert_retired_player", record.name, record.score, record.play_time);
+    });
+}
+
+void RecordsRepositoryImpl::AddRecords(const std::vector<application::PlayerRecord>& records) {
+    if (records.empty()) {
+        return;
+    }
+
+    // columns are passed as arrays and unnested into rows
+    std::vector<std::string> names;
+    std::vector<int> scores;
+    std::vector<double> play_times;
+    names.reserve(records.size());
+    scores.reserve(records.size());
+    play_times.reserve(records.size());
+    for (const auto& record : records) {
+        names.push_back(record.name);
+        scores.push_back(record.score);
+        play_times.push_back(record.play_time);
+    }
+
+    RejectInvalidRecords([&] {
+        tr_.exec_prepared("insert_retired_players", names, scores, play_times);
+    });
 }
  
 std::vector<application::PlayerRecord> RecordsRepositoryImpl::GetRecords(std::size_t start, std::size_t max_items) {
@@ -64,7 +113,10 @@ application::RecordsRepository& UnitOfWorkImpl::GetRecords() {
 
 void UnitOfWorkImpl::Commit() {
     if (!committed_) {
-        tr_.commit();
+        // deferred constraints are checked here
+        RejectInvalidRecords([this] {
+            tr_.commit();
+        });
         committed_ = true;
     }
 }
@@ -79,9 +131,12 @@ Database::Database(std::string db_url, std::size_t pool_capacity)
         auto conn = std::make_shared<pqxx::connection>(db_url);
         conn->prepare("insert_retired_player",
                       "INSERT INTO retired_players (name, score, play_time) VALUES ($1, $2, $3);");
+        conn->prepare("insert_retired_players",
+                      "INSERT INTO retired_players (name, score, play_time) "
+                      "SELECT * FROM unnest($1::text[], $2::integer[], $3::double precision[]);");
         conn->prepare("select_records",
                       "SELECT name, score, play_time FROM retired_players "
-                      "ORDER BY score DESC, play_time ASC, name ASC "
+                      "ORDER BY score DESC, play_time ASC, name COLLATE \"C\" ASC "
                       "OFFSET $1 LIMIT $2;");
         return conn;
     }} {
@@ -22,6 +22,8 @@ public:
     }
 
     void AddRecord(const application::PlayerRecord& record) override;
+    // one statement for the whole batch
+    void AddRecords(const std::vector<application::PlayerRecord>& records) override;
     std::vector<application::PlayerRecord> GetRecords(std::size_t start, std::size_t max_items) override;
 
 private:
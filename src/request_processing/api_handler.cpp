@@ -9,8 +9,11 @@
 
 #include "make_response.h"
 #include "path_handler.h"
+#include "binary_state.h"
+#include "etag.h"
 #include "../detail/position.h"
 #include "../configuration/map_to_json.h"
+#include "../detail/json_writer.h"
 
 namespace {
 
@@ -27,7 +30,7 @@ bool IsValidToken(std::string_view token) {
     });
 }
 
-std::string DirectionToLetter(pos::Direction dir) {
+std::string_view DirectionToLetter(pos::Direction dir) {
     switch (dir) {
         case pos::Direction::NORTH:
             return "U";
@@ -59,6 +62,132 @@ pos::Direction LetterToDirection(const std::string& letter) {
 
 }
 
+// returns the token of a well-formed "Bearer" authorization header
+std::optional<application::Token> FindBearerToken(const StringRequest& request) {
+    auto it = request.find(http::field::authorization);
+    if (it == request.end()) {
+        return std::nullopt;
+    }
+
+    std::string_view auth = it->value();
+    constexpr std::string_view prefix = "Bearer ";
+    if (!auth.starts_with(prefix)) {
+        return std::nullopt;
+    }
+
+    return application::Token::FromHex(auth.substr(prefix.size()));
+}
+
+void WritePlayerState(util::JsonWriter& writer, const model::Dog& dog) {
+    const pos::Position& pos = dog.GetPosition();
+
+    writer.BeginObject();
+    writer.Key("pos").BeginArray().Value(pos.coordinates_.x).Value(pos.coordinates_.y).EndArray();
+    writer.Key("speed").BeginArray().Value(pos.velocity_.vx).Value(pos.velocity_.vy).EndArray();
+    writer.Key("dir").Value(DirectionToLetter(pos.direction_));
+
+    writer.Key("bag").BeginArray();
+    for (const auto& [item_id, info] : dog.GetCollectedItems()) {
+        writer.BeginObject();
+        writer.Key("id").Value(item_id);
+        writer.Key("type").Value(static_cast<int>(info.type));
+        writer.EndObject();
+    }
+    writer.EndArray();
+    writer.Key("score").Value(dog.GetScore());
+    writer.EndObject();
+}
+
+void WriteLootState(util::JsonWriter& writer, const model::LootItem& item) {
+    writer.BeginObject();
+    writer.Key("type").Value(static_cast<int>(item.info.type));
+    writer.Key("pos").BeginArray().Value(item.coordinate.x).Value(item.coordinate.y).EndArray();
+    writer.EndObject();
+}
+
+// returns the value of the first query parameter with the given name
+std::optional<std::string_view> FindQueryParameter(std::string_view target, std::string_view name) {
+    const auto qpos = target.find('?');
+    if (qpos == std::string_view::npos) {
+        return std::nullopt;
+    }
+
+    std::string_view query = target.substr(qpos + 1);
+    while (!query.empty()) {
+        auto amp = query.find('&');
+        std::string_view chunk = (amp == std::string_view::npos) ? query : query.substr(0, amp);
+        query = (amp == std::string_view::npos) ? std::string_view{} : query.substr(amp + 1);
+
+        auto eq = chunk.find('=');
+        if (eq != std::string_view::npos && chunk.substr(0, eq) == name) {
+            return chunk.substr(eq + 1);
+        }
+    }
+    return std::nullopt;
+}
+
+// true if the Accept header lists the media type with a non-zero quality,
+// wildcards are not taken into account, so "*/*" keeps the JSON default
+bool AcceptsMediaType(const StringRequest& request, std::string_view media_type) {
+    auto it = request.find(http::field::accept);
+    if (it == request.end()) {
+        return false;
+    }
+
+    std::string_view accept = it->value();
+    while (!accept.empty()) {
+        auto comma = accept.find(',');
+        std::string_view range = accept.substr(0, comma);
+        accept = (comma == std::string_view::npos) ? std::string_view{} : accept.substr(comma + 1);
+
+        std::string_view params;
+        if (auto semicolon = range.find(';'); semicolon != std::string_view::npos) {
+            params = range.substr(semicolon + 1);
+            range = range.substr(0, semicolon);
+        }
+
+        while (!range.empty() && range.front() == ' ') {
+            range.remove_prefix(1);
+        }
+        while (!range.empty() && range.back() == ' ') {
+            range.remove_suffix(1);
+        }
+        if (range != media_type) {
+            continue;
+        }
+
+        // "q=0", "q=0.0" and so on exclude the type
+        if (auto q = params.find("q="); q != std::string_view::npos) {
+            std::string_view value = params.substr(q + 2);
+            value = value.substr(0, value.find(';'));
+            return value.find_first_not_of("0. ") != std::string_view::npos;
+        }
+        return true;
+    }
+    return false;
+}
+
+// parses {"move": "U"|"D"|"L"|"R"|""} and moves or stops the player, throws on invalid commands
+void ApplyMoveCommand(application::Application& app, application::Player::Id player_id, std::string_view body) {
+    json::value body_json = json::parse(body);
+    if (!body_json.is_object()) {
+        throw std::invalid_argument("");
+    }
+
+    const auto* user_move_dir_it = body_json.as_object().if_contains("move");
+    if (!user_move_dir_it || !user_move_dir_it->is_string()) {
+        throw std::invalid_argument("");
+    }
+
+    const std::string move = user_move_dir_it->as_string().c_str();
+    if (move.empty()) {
+        app.StopPlayer(player_id);
+    } 
+    else {
+        app.MovePlayer(player_id, LetterToDirection(move));
+    }
+}
+
 std::optional<std::size_t> ParseSize(std::string_view s) {
     std::size_t value = 0;
     auto first = s.data();
@@ -77,20 +206,70 @@ namespace http_handler {
 namespace json = boost::json;
 namespace fs = std::filesystem;
 
-json::array ApiHandler::GetAllMapsAsJsonArray() const {
-    json::array maps_array;
+void ApiHandler::PrepareMapBodies() {
+    map_list_body_ = MakePreparedBody(SerializeMapList());
 
+    for (const auto& map : app_.GetAllMaps()) {
+        std::string body;
+        util::JsonWriter writer{body};
+        config::WriteMapJson(writer, map, loot_metadata_);
+        map_bodies_[map.GetId()] = MakePreparedBody(std::move(body));
+    }
+}
+
+ApiHandler::PreparedBody ApiHandler::MakePreparedBody(std::string body, CompressionLevel level) {
+    PreparedBody prepared;
+    prepared.etags = MakeEncodedETags(MakeStrongETag(body));
+    prepared.bodies = CompressAll(std::make_shared<const std::string>(std::move(body)), level);
+    return prepared;
+}
+
+SharedResponse ApiHandler::MakePreparedResponse(const StringRequest& req, const PreparedBody& prepared) const {
+    auto encoding = ChooseContentEncoding(req);
+    if (!prepared.bodies[static_cast<size_t>(encoding)]) {
+        encoding = ContentEncoding::Identity;
+    }
+    const auto index = static_cast<size_t>(encoding);
+
+    if (MatchesIfNoneMatch(req, prepared.etags[index])) {
+        SharedResponse res(http::status::not_modified, req.version());
+        res.set(http::field::etag, prepared.etags[index]);
+        res.set(http::field::cache_control, "no-cache");
+        res.set(http::field::vary, "Accept-Encoding");
+        res.keep_alive(req.keep_alive());
+        return res;
+    }
+
+    auto res = MakeSharedResponse(http::status::ok, prepared.bodies[index], req.version(), req.keep_alive());
+    res.set(http::field::etag, prepared.etags[index]);
+    res.set(http::field::vary, "Accept-Encoding");
+    if (encoding != ContentEncoding::Identity) {
+        res.set(http::field::content_encoding, ContentEncodingName(encoding));
+    }
+    if (req.method() == http::verb::head) {
+        res.body().reset();
+    }
+    return res;
+}
+
+std::string ApiHandler::SerializeMapList() const {
+    std::string body;
+    util::JsonWriter writer{body};
+
+    writer.BeginArray();
     for (auto& map_obj : app_.GetAllMaps()) {
-        json::object map;
-        map["id"] = static_cast<std::string>(*map_obj.GetId());
-        map["name"] = map_obj.GetName();
-        maps_array.push_back(std::move(map));
+        writer.BeginObject();
+        writer.Key("id").Value(*map_obj.GetId());
+        writer.Key("name").Value(map_obj.GetName());
+        writer.EndObject();
     }
+    writer.EndArray();
 
-    return maps_array;
+    return body;
 }
 
-std::optional<StringResponse> ApiHandler::CheckAuthorizationAndToken(const StringRequest& request, application::Player::Id& player_id) const {
+std::optional<StringResponse> ApiHandler::CheckAuthorizationAndToken(const StringRequest& request, AuthCache& auth, 
+                                                                     application::Player::Id& player_id) const {
     // check authorization header
     auto it = request.find(http::field::authorization);
     if (it == request.end()) {
@@ -99,34 +278,75 @@ std::optional<StringResponse> ApiHandler::CheckAuthorizationAndToken(const Strin
     }
 
     // check bearer
-    std::string_view auth = it->value();
+    std::string_view auth_header = it->value();
     constexpr std::string_view prefix = "Bearer ";
 
-    if (!auth.starts_with(prefix) || auth.size() <= prefix.size()) {
+    if (!auth_header.starts_with(prefix) || auth_header.size() <= prefix.size()) {
         return MakeErrorResponse(http::status::unauthorized,
             "invalidToken", "Authorization header is invalid", request);
     }
     
-    // check token
-    std::string token = std::string(auth.substr(prefix.size()));
-    if (!IsValidToken(token)) {
+    // check token, it is parsed straight from the header
+    const std::string_view token_text = auth_header.substr(prefix.size());
+    const auto token = application::Token::FromHex(token_text);
+    if (!token && !IsValidToken(token_text)) {
         return MakeErrorResponse(http::status::unauthorized,
             "invalidToken", "Authorization header is invalid", request);
     }
 
-    auto player_id_opt = app_.FindPlayerIdByToken(token);
-    if (!player_id_opt) {
+    // issued tokens are lowercase, any other spelling is unknown
+    const auto player = token ? FindTokenPlayer(*token, auth) : std::nullopt;
+    if (!player) {
         return MakeErrorResponse(http::status::unauthorized,
             "unknownToken", "Player token has not been found", request);
     }
 
     // find player
-    player_id = *player_id_opt;
+    player_id = player->id;
 
     return std::nullopt;
 }
 
-StringResponse ApiHandler::HandleJoinGame(const StringRequest& request) {
+std::optional<AuthorizedPlayer> ApiHandler::FindTokenPlayer(const application::Token& token, AuthCache& auth) const {
+    // the generation is read before the lookup, so a token revoked during the lookup
+    // leaves a stale entry that is never used
+    const uint64_t generation = app_.GetTokenGeneration();
+    if (auth.valid && auth.generation == generation && auth.token == token.GetBytes()) {
+        return AuthorizedPlayer{auth.subject, model::Map::Id{auth.scope}};
+    }
+
+    const auto owner = app_.FindTokenOwner(token);
+    if (!owner) {
+        return std::nullopt;
+    }
+
+    auth.token = token.GetBytes();
+    auth.subject = owner->player_id;
+    auth.scope = *owner->map_id;
+    auth.generation = generation;
+    auth.valid = true;
+    return AuthorizedPlayer{owner->player_id, owner->map_id};
+}
+
+std::optional<JoinRequest> ApiHandler::ParseJoinRequest(const StringRequest& request) {
+    json::error_code ec;
+    json::value body_json = json::parse(request.body(), ec);
+    if (ec || !body_json.is_object()) {
+        return std::nullopt;
+    }
+
+    const auto& obj = body_json.as_object();
+    const auto* user_name_it = obj.if_contains("userName");
+    const auto* map_id_it = obj.if_contains("mapId");
+    if (!user_name_it || !map_id_it || !user_name_it->is_string() || !map_id_it->is_string()) {
+        return std::nullopt;
+    }
+
+    return JoinRequest{std::string(user_name_it->as_string().c_str()), 
+                       model::Map::Id{std::string(map_id_it->as_string().c_str())}};
+}
+
+StringResponse ApiHandler::HandleJoinGame(const StringRequest& request, const std::optional<JoinRequest>& join) {
     // check method
     if (request.method() != http::verb::post) {
         StringResponse res = MakeErrorResponse(http::status::method_not_allowed, 
@@ -142,34 +362,12 @@ StringResponse ApiHandler::HandleJoinGame(const StringRequest& request) {
                                 "invalidContentType", "Content-Type must be application/json", request);
     }
 
-    // parse body
-    json::value body_json;
-    std::string user_name;
-    std::string map_id;
-
-    try {
-        body_json = json::parse(request.body());
-
-        if (!body_json.is_object()) {
-            throw std::invalid_argument("");
-        }
-
-        const auto& obj = body_json.as_object();
-
-        // get user_name and map_id
-        const auto* user_name_it = obj.if_contains("userName");
-        const auto* map_id_it = obj.if_contains("mapId");
-
-        if (!user_name_it || !map_id_it || !user_name_it->is_string() || !map_id_it->is_string()) {
-            throw std::invalid_argument("");
-        }
-
-        user_name = std::string(user_name_it->as_string().c_str());
-        map_id = std::string(map_id_it->as_string().c_str());
-    }
-    catch (const std::exception&) {
+    // the body was parsed by RouteRequest
+    if (!join) {
         return MakeInvalidArgument(request, "Join game request parse error");
     }
+    const std::string& user_name = join->user_name;
+    const std::string& map_id = *join->map_id;
 
     //  check if user_name is empty
     if (user_name.empty()) {
@@ -177,18 +375,26 @@ StringResponse ApiHandler::HandleJoinGame(const StringRequest& request) {
     }
 
     // check if map exists
-    const model::Map* map_ptr = app_.FindMapByMapId(model::Map::Id(map_id));
+    const model::Map* map_ptr = app_.FindMapByMapId(join->map_id);
     if (!map_ptr) {
         return MakeErrorResponse(http::status::not_found,
             "mapNotFound", "Map not found", request);
     }
 
+    // while the database is down, the players who would retire later have nowhere to go
+    if (app_.IsRecordsBacklogged()) {
+        StringResponse res = MakeErrorResponse(http::status::service_unavailable, 
+            "serviceUnavailable", "Records cannot be saved now, try again later", request);
+        res.set(http::field::retry_after, "5");
+        return res;
+    }
+
     // join game
     application::Application::JoinResult join_result = app_.JoinGame(user_name, map_id);
 
     // join response
     json::object resp_obj;
-    resp_obj["authToken"] = join_result.token;
+    resp_obj["authToken"] = join_result.token.ToHex();
     resp_obj["playerId"]  = join_result.player_id;
     std::string body = json::serialize(resp_obj);
 
@@ -196,7 +402,7 @@ StringResponse ApiHandler::HandleJoinGame(const StringRequest& request) {
                                             request.keep_alive(), ContentType::JSON);
 }
 
-StringResponse ApiHandler::HandleGetPlayers(const StringRequest& request) const {
+StringResponse ApiHandler::HandleGetPlayers(const StringRequest& request, AuthCache& auth) const {
     // check method
     if (request.method() != http::verb::get && request.method() != http::verb::head) {
         StringResponse res = MakeErrorResponse(http::status::method_not_allowed,
@@ -206,27 +412,26 @@ StringResponse ApiHandler::HandleGetPlayers(const StringRequest& request) const
     }
 
     application::Player::Id player_id;
-    auto check_token_res = CheckAuthorizationAndToken(request, player_id);
+    auto check_token_res = CheckAuthorizationAndToken(request, auth, player_id);
     if (check_token_res) {
         return *check_token_res;
     }
 
     const application::Player* player = app_.FindPlayerById(player_id);
-
-    json::object result;
-    for (const auto& p : app_.GetPlayersInMap(player->GetMapId())) {
-        const model::Dog* dog = p.GetDog();
-        if (dog) {
-            json::object dog_obj;
-            dog_obj["name"] = dog->GetName();
-            result[std::to_string(p.GetId())] = dog_obj;
-        }
+    const model::GameSession& session = app_.GetMapSession(player->GetMapId());
+
+    // dog ids are the ids of their players
+    std::string body;
+    util::JsonWriter writer{body};
+    writer.BeginObject();
+    for (const model::Dog& dog : session.GetAllDogs()) {
+        writer.Key(dog.GetId()).BeginObject();
+        writer.Key("name").Value(session.GetDogName(dog.GetId()));
+        writer.EndObject();
     }
+    writer.EndObject();
 
-    std::string body = json::serialize(result);
-    StringResponse res = MakeStringResponse(http::status::ok, body, request.version(),
-                                            request.keep_alive(), ContentType::JSON);
-    res.set(http::field::cache_control, "no-cache");
+    StringResponse res = MakeJsonResponse(http::status::ok, std::move(body), request.version(), request.keep_alive());
     
     if (request.method() == http::verb::head) {
         res.body().clear();
@@ -235,7 +440,7 @@ StringResponse ApiHandler::HandleGetPlayers(const StringRequest& request) const
     return res;
 }
 
-StringResponse ApiHandler::HandleGetGameState(const StringRequest& request) const {
+ApiResponse ApiHandler::HandleGetGameState(const StringRequest& request, AuthCache& auth) const {
     // check method
     if (request.method() != http::verb::get && request.method() != http::verb::head) {
         StringResponse res = MakeErrorResponse(http::status::method_not_allowed,
@@ -245,68 +450,189 @@ StringResponse ApiHandler::HandleGetGameState(const StringRequest& request) cons
     }
 
     application::Player::Id player_id;
-    auto check_token_res = CheckAuthorizationAndToken(request, player_id);
+    auto check_token_res = CheckAuthorizationAndToken(request, auth, player_id);
     if (check_token_res) {
         return *check_token_res;
     }
 
     const application::Player* player = app_.FindPlayerById(player_id);
+    const model::Map::Id& map_id = player->GetMapId();
+    const bool binary = AcceptsMediaType(request, ContentType::GAME_STATE);
+    const auto state = binary ? GetBinaryStateSnapshot(map_id) : GetStateSnapshot(map_id);
 
-    json::object root;
-    json::object players_obj;
-    for (const auto& p : app_.GetPlayersInMap(player->GetMapId())) {
-        json::object player_pos;
-        const pos::Position& pos = p.GetPosition();
-
-        json::array coordinates_arr;
-        coordinates_arr.push_back(pos.coordinates_.x);
-        coordinates_arr.push_back(pos.coordinates_.y);
-
-        json::array velocity_arr;
-        velocity_arr.push_back(pos.velocity_.vx);
-        velocity_arr.push_back(pos.velocity_.vy);
-
-        player_pos["pos"] = coordinates_arr;
-        player_pos["speed"] = velocity_arr;
-        player_pos["dir"] = DirectionToLetter(pos.direction_);
-
-        std::vector<std::pair<size_t, size_t>> collected_items = p.GetCollectedItems();
-        json::array collected_items_arr;
-        for (const auto& item : collected_items) {
-            json::object item_obj;
-            item_obj["id"] = item.first; // id
-            item_obj["type"] = item.second; // type
-            collected_items_arr.push_back(item_obj);
-        }
-        player_pos["bag"] = collected_items_arr;
-        player_pos["score"] = p.GetScore();
+    const ContentEncoding encoding = ChooseContentEncoding(request);
+    const auto encoded = GetEncodedSnapshot(binary ? binary_state_cache_ : state_cache_, map_id, state, encoding);
 
-        players_obj[std::to_string(p.GetId())] = std::move(player_pos);
+    SharedResponse res = MakeSharedResponse(http::status::ok, encoded ? encoded : state, request.version(),
+                                            request.keep_alive(), binary ? ContentType::GAME_STATE : ContentType::JSON);
+    res.set(http::field::cache_control, "no-cache");
+    res.set(http::field::vary, "Accept, Accept-Encoding");
+    if (encoded) {
+        res.set(http::field::content_encoding, ContentEncodingName(encoding));
     }
-    root["players"] = std::move(players_obj);
+    
+    if (request.method() == http::verb::head) {
+        res.body().reset();
+    }
+
+    return res;
+}
+
+StateCache::Snapshot ApiHandler::GetStateSnapshot(const model::Map::Id& map_id) const {
+    // the snapshot is shared by all clients of the map until its state changes
+    return state_cache_.Get(map_id, app_.GetMapStateVersion(map_id), [&] {
+        return SerializeGameState(map_id);
+    });
+}
 
-    json::object items_obj;
+StateCache::Snapshot ApiHandler::GetBinaryStateSnapshot(const model::Map::Id& map_id) const {
+    return binary_state_cache_.Get(map_id, app_.GetMapStateVersion(map_id), [&] {
+        return EncodeBinaryGameState(app_.GetMapSession(map_id));
+    });
+}
+
+StateCache::Snapshot ApiHandler::GetEncodedSnapshot(StateCache& cache, const model::Map::Id& map_id, 
+                                                    const StateCache::Snapshot& snapshot, 
+                                                    ContentEncoding encoding) const {
+    if (encoding == ContentEncoding::Identity || snapshot->size() < kMinCompressedSize) {
+        return nullptr;
+    }
+
+    // the variant of an encoding is its index, an empty variant means compression did not pay off
+    static_assert(StateCache::kMaxVariants >= kContentEncodingCount);
+    auto encoded = cache.Get(map_id, app_.GetMapStateVersion(map_id), [&] {
+        return Compress(*snapshot, encoding, CompressionLevel::Fast).value_or(std::string{});
+    }, static_cast<size_t>(encoding));
+
+    if (encoded->empty()) {
+        return nullptr;
+    }
+    return encoded;
+}
+
+std::string ApiHandler::SerializeGameState(const model::Map::Id& map_id) const {
+    const model::GameSession& session = app_.GetMapSession(map_id);
+
+    std::string body;
+    util::JsonWriter writer{body};
+    writer.BeginObject();
+
+    // dog ids are the ids of their players
+    writer.Key("players").BeginObject();
+    for (const model::Dog& dog : session.GetAllDogs()) {
+        writer.Key(dog.GetId());
+        WritePlayerState(writer, dog);
+    }
+    writer.EndObject();
+
+    // lost objects are numbered by their position
+    writer.Key("lostObjects").BeginObject();
     size_t item_counter = 0;
-    for (const auto& item : app_.GetItemsInMap(player->GetMapId())) {
-        json::object item_json;
-        
-        json::array coordinates_arr;
-        coordinates_arr.push_back(item.coordinate.x);
-        coordinates_arr.push_back(item.coordinate.y);
+    session.ForEachLootItem([&](const model::LootItem& item) {
+        writer.Key(item_counter++);
+        WriteLootState(writer, item);
+    });
+    writer.EndObject();
 
-        item_json["type"] = static_cast<int>(item.info.type);
-        item_json["pos"] = coordinates_arr;
+    writer.EndObject();
+    return body;
+}
 
-        items_obj[std::to_string(item_counter)] = item_json;
-        ++item_counter;
+StringResponse ApiHandler::HandleGetGameStateDelta(const StringRequest& request, AuthCache& auth) const {
+    // check method
+    if (request.method() != http::verb::get && request.method() != http::verb::head) {
+        StringResponse res = MakeErrorResponse(http::status::method_not_allowed,
+            "invalidMethod", "Only GET and HEAD methods are expected", request);
+        res.set(http::field::allow, "GET, HEAD");
+        return res;
     }
-    root["lostObjects"] = std::move(items_obj);
 
-    std::string body = json::serialize(root);
-    StringResponse res = MakeStringResponse(http::status::ok, body, request.version(),
-                                            request.keep_alive(), ContentType::JSON);
-    res.set(http::field::cache_control, "no-cache");
-    
+    application::Player::Id player_id;
+    auto check_token_res = CheckAuthorizationAndToken(request, auth, player_id);
+    if (check_token_res) {
+        return *check_token_res;
+    }
+
+    // without "since" the client gets the full state
+    std::optional<std::size_t> since;
+    if (auto value = FindQueryParameter(request.target(), "since")) {
+        since = ParseSize(*value);
+        if (!since) {
+            return MakeInvalidArgument(request, "since must be a non-negative integer");
+        }
+    }
+
+    const application::Player* player = app_.FindPlayerById(player_id);
+    const model::Map::Id& map_id = player->GetMapId();
+    const uint64_t version = app_.GetMapStateVersion(map_id);
+
+    std::optional<model::StateDelta> delta;
+    if (since) {
+        delta = app_.GetMapChangesSince(map_id, *since);
+    }
+
+    const model::GameSession& session = app_.GetMapSession(map_id);
+
+    std::string body;
+    util::JsonWriter writer{body};
+    writer.BeginObject();
+    writer.Key("seq").Value(version);
+    writer.Key("full").Value(!delta.has_value());
+
+    writer.Key("players").BeginObject();
+    if (delta) {
+        for (uint32_t dog_id : delta->changed_dogs) {
+            const auto handle = session.FindDogHandle(static_cast<int>(dog_id));
+            if (const model::Dog* dog = handle ? session.GetDog(*handle) : nullptr) {
+                writer.Key(dog_id);
+                WritePlayerState(writer, *dog);
+            }
+        }
+    }
+    else {
+        for (const model::Dog& dog : session.GetAllDogs()) {
+            writer.Key(dog.GetId());
+            WritePlayerState(writer, dog);
+        }
+    }
+    writer.EndObject();
+
+    writer.Key("removedPlayers").BeginArray();
+    if (delta) {
+        for (uint32_t dog_id : delta->removed_dogs) {
+            writer.Value(dog_id);
+        }
+    }
+    writer.EndArray();
+
+    writer.Key("lostObjects").BeginObject();
+    if (delta) {
+        for (uint32_t item_id : delta->added_loot) {
+            if (const model::LootItem* item = session.GetLootItem(item_id)) {
+                writer.Key(item_id);
+                WriteLootState(writer, *item);
+            }
+        }
+    }
+    else {
+        session.ForEachLootItem([&writer](const model::LootItem& item) {
+            writer.Key(item.id);
+            WriteLootState(writer, item);
+        });
+    }
+    writer.EndObject();
+
+    writer.Key("removedObjects").BeginArray();
+    if (delta) {
+        for (uint32_t item_id : delta->removed_loot) {
+            writer.Value(item_id);
+        }
+    }
+    writer.EndArray();
+    writer.EndObject();
+
+    StringResponse res = MakeJsonResponse(http::status::ok, std::move(body), request.version(), request.keep_alive());
+
     if (request.method() == http::verb::head) {
         res.body().clear();
     }
@@ -314,7 +640,7 @@ StringResponse ApiHandler::HandleGetGameState(const StringRequest& request) cons
     return res;
 }
 
-StringResponse ApiHandler::HandleGetRecords(const StringRequest& request) const {
+ApiResponse ApiHandler::HandleGetRecords(const StringRequest& request) const {
     if (request.method() != http::verb::get && request.method() != http::verb::head) {
         return MakeBadRequest(request, "Invalid method");
     }
@@ -364,28 +690,60 @@ StringResponse ApiHandler::HandleGetRecords(const StringRequest& request) const
         return MakeInvalidArgument(request, "maxItems must be <= 100");
     }
 
-    const auto records = app_.GetPlayerRecords(start, max_items);
-    json::array arr;
-    arr.reserve(records.size());
-    for (const auto& rec : records) {
-        json::object obj;
-        obj["name"] = rec.name;
-        obj["score"] = rec.score;
-        obj["playTime"] = rec.play_time;
-        arr.emplace_back(std::move(obj));
+    // pages inside the leaderboard are served pre-serialized, the rest comes from the database
+    if (const auto version = app_.GetPlayerRecordsVersion(start, max_items)) {
+        return MakePreparedResponse(request, *GetRecordsPage(start, max_items, *version));
     }
 
-    const std::string body = json::serialize(arr);
-    auto resp = MakeStringResponse(http::status::ok, body, request.version(), request.keep_alive(), ContentType::JSON);
-    resp.set(http::field::cache_control, "no-cache");
+    auto resp = MakeJsonResponse(http::status::ok, SerializeRecords(app_.GetPlayerRecords(start, max_items)), 
+                                 request.version(), request.keep_alive());
     if (request.method() == http::verb::head) {
         resp.body().clear();
-        resp.content_length(body.size());
     }
     return resp;
 }
 
-StringResponse ApiHandler::HandleMovePlayer(const StringRequest& request) {
+std::string ApiHandler::SerializeRecords(const std::vector<application::PlayerRecord>& records) {
+    std::string body;
+    util::JsonWriter writer{body};
+    writer.BeginArray();
+    for (const auto& rec : records) {
+        writer.BeginObject();
+        writer.Key("name").Value(rec.name);
+        writer.Key("score").Value(rec.score);
+        writer.Key("playTime").Value(rec.play_time);
+        writer.EndObject();
+    }
+    writer.EndArray();
+    return body;
+}
+
+std::shared_ptr<const ApiHandler::PreparedBody> ApiHandler::GetRecordsPage(std::size_t start, std::size_t max_items, 
+                                                                           uint64_t version) const {
+    const auto key = std::make_pair(start, max_items);
+
+    std::lock_guard lock{records_mutex_};
+    if (version != records_version_) {
+        records_pages_.clear();
+        records_version_ = version;
+    }
+    else if (auto it = records_pages_.find(key); it != records_pages_.end()) {
+        return it->second;
+    }
+    else if (records_pages_.size() >= kMaxRecordsPages) {
+        // odd page sizes should not grow the cache without bound
+        records_pages_.clear();
+    }
+
+    // a retirement may land between the version and the records, then the page is newer than its key
+    // and is replaced with the next version
+    auto page = std::make_shared<const PreparedBody>(
+        MakePreparedBody(SerializeRecords(app_.GetPlayerRecords(start, max_items)), CompressionLevel::Fast));
+    records_pages_.emplace(key, page);
+    return page;
+}
+
+ApiResponse ApiHandler::HandleMovePlayer(const StringRequest& request, AuthCache& auth) {
     // check method
     if (request.method() != http::verb::post) {
         StringResponse res = MakeErrorResponse(http::status::method_not_allowed,
@@ -401,44 +759,48 @@ StringResponse ApiHandler::HandleMovePlayer(const StringRequest& request) {
     }
 
     application::Player::Id player_id;
-    auto check_token_res = CheckAuthorizationAndToken(request, player_id);
+    auto check_token_res = CheckAuthorizationAndToken(request, auth, player_id);
     if (check_token_res) {
         return *check_token_res;
     }
 
     // parse body
-    json::value body_json;
     try {
-        body_json = json::parse(request.body());
-
-        if (!body_json.is_object()) {
-            throw std::invalid_argument("");
-        }
+        ApplyMoveCommand(app_, player_id, request.body());
+    } 
+    catch (const std::exception&) {
+        return MakeInvalidArgument(request, "Failed to parse action");
+    }
 
-        const auto& obj = body_json.as_object();
+    return MakeSharedResponse(http::status::ok, EmptyJsonObject(), request.version(), request.keep_alive());
+}
 
-        const auto* user_move_dir_it = obj.if_contains("move");
-        if (!user_move_dir_it || !user_move_dir_it->is_string()) {
-            throw std::invalid_argument("");
-        }
+StringResponse ApiHandler::HandleGameSocket(const StringRequest& request, AuthCache& auth) const {
+    application::Player::Id player_id;
+    auto check_token_res = CheckAuthorizationAndToken(request, auth, player_id);
+    if (check_token_res) {
+        return *check_token_res;
+    }
 
-        const std::string move = user_move_dir_it->as_string().c_str();
-        if (move.empty()) {
-            app_.StopPlayer(player_id);
-        } 
-        else {
-            app_.MovePlayer(player_id, LetterToDirection(move));
-        }
+    // authorized requests that reach this point are not websocket upgrades
+    StringResponse res = MakeErrorResponse(http::status::upgrade_required,
+        "upgradeRequired", "WebSocket upgrade is expected", request);
+    res.set(http::field::upgrade, "websocket");
+    res.set(http::field::connection, "Upgrade");
+    return res;
+}
 
-    } 
+bool ApiHandler::HandleSocketMessage(application::Player::Id player_id, std::string_view message) {
+    try {
+        ApplyMoveCommand(app_, player_id, message);
+    }
     catch (const std::exception&) {
-        return MakeInvalidArgument(request, "Failed to parse action");
+        return false;
     }
-
-    return MakeStringResponse(http::status::ok, "{}", request.version(), request.keep_alive());
+    return true;
 }
 
-StringResponse ApiHandler::HandleTick(const StringRequest& request) {
+ApiResponse ApiHandler::HandleTick(const StringRequest& request) {
     // check method
     if (request.method() != http::verb::post) {
         StringResponse res = MakeErrorResponse(http::status::method_not_allowed,
@@ -479,10 +841,10 @@ StringResponse ApiHandler::HandleTick(const StringRequest& request) {
         return MakeInvalidArgument(request, "Failed to parse tick request JSON");
     }
 
-    return MakeStringResponse(http::status::ok, "{}", request.version(), request.keep_alive());
+    return MakeSharedResponse(http::status::ok, EmptyJsonObject(), request.version(), request.keep_alive());
 }
 
-StringResponse ApiHandler::HandleMapsEndpoint(const StringRequest& req, PathIt it, PathIt end) const {
+ApiResponse ApiHandler::HandleMapsEndpoint(const StringRequest& req, PathIt it, PathIt end) const {
     if (req.method() != http::verb::get && req.method() != http::verb::head) {
         StringResponse res = MakeErrorResponse(http::status::method_not_allowed,
             "invalidMethod", "Invalid method", req);
@@ -492,33 +854,20 @@ StringResponse ApiHandler::HandleMapsEndpoint(const StringRequest& req, PathIt i
 
     // /api/v1/maps
     if (it == end) {
-        auto text = json::serialize(GetAllMapsAsJsonArray());
-        auto res = MakeStringResponse(http::status::ok, text, req.version(), req.keep_alive());
-
-        if (req.method() == http::verb::head) {
-            res.body().clear();
-        }
-        return res;
+        return MakePreparedResponse(req, map_list_body_);
     }
 
     // /api/v1/maps/<id>
-    model::Map::Id id(it->string());
-    const model::Map* map_ptr = app_.FindMapByMapId(id);
-    if (!map_ptr) {
+    auto map_it = map_bodies_.find(model::Map::Id{it->string()});
+    if (map_it == map_bodies_.end()) {
         return MakeErrorResponse(http::status::not_found,
             "mapNotFound", "Map not found", req);
     }
-
-    auto text = json::serialize(config::GetMapAsJsonObject(map_ptr, loot_metadata_));
-    auto res = MakeStringResponse(http::status::ok, text, req.version(), req.keep_alive());
-
-    if (req.method() == http::verb::head) {
-        res.body().clear();
-    }
-    return res;
+    return MakePreparedResponse(req, map_it->second);
 }
 
-StringResponse ApiHandler::HandleGameEndpoint(const StringRequest& req, PathIt it, PathIt end) {
+ApiResponse ApiHandler::HandleGameEndpoint(const StringRequest& req, PathIt it, PathIt end, AuthCache& auth, 
+                                           const RequestRoute& route) {
     if (it == end) {
         return MakeBadRequest(req, "Bad Request");
     }
@@ -531,28 +880,39 @@ StringResponse ApiHandler::HandleGameEndpoint(const StringRequest& req, PathIt i
     }
 
     if (*it == "join") {
-        return HandleJoinGame(req);
+        return HandleJoinGame(req, route.join);
     }
 
     if (*it == "players") {
-        return HandleGetPlayers(req);
+        return HandleGetPlayers(req, auth);
     }
 
     if (*it == "state") {
-        return HandleGetGameState(req);
+        ++it;
+        if (it == end) {
+            return HandleGetGameState(req, auth);
+        }
+        if (*it == "delta") {
+            return HandleGetGameStateDelta(req, auth);
+        }
+        return MakeBadRequest(req, "Bad Request");
     }
 
     if (*it == "records") {
         return HandleGetRecords(req);
     }
 
+    if (*it == "socket") {
+        return HandleGameSocket(req, auth);
+    }
+
     if (*it == "player") {
         ++it;
         if (it == end) {
             return MakeBadRequest(req, "Bad Request");
         }
         if (*it == "action") {
-            return HandleMovePlayer(req);
+            return HandleMovePlayer(req, auth);
         }
         return MakeBadRequest(req, "Bad Request");
     }
@@ -560,7 +920,76 @@ StringResponse ApiHandler::HandleGameEndpoint(const StringRequest& req, PathIt i
     return MakeBadRequest(req, "Bad Request");
 }
 
-StringResponse ApiHandler::HandleRequest(const StringRequest& req) {
+RequestRoute ApiHandler::RouteRequest(const StringRequest& req, AuthCache& auth) const {
+    fs::path url;
+    try {
+        url = MakePathFromTarget(req);
+    }
+    catch (...) {
+        return {};
+    }
+
+    // /api/v1/game/<endpoint>
+    auto it = url.begin();
+    auto end = url.end();
+    if (it == end || ++it == end || *it != "v1" || ++it == end || *it != "game" || ++it == end) {
+        return {};
+    }
+
+    if (*it == "join") {
+        RequestRoute route;
+        route.join = ParseJoinRequest(req);
+        if (route.join && app_.FindMapByMapId(route.join->map_id)) {
+            route.map_id = route.join->map_id;
+        }
+        return route;
+    }
+
+    if (*it == "players" || *it == "state" || *it == "player") {
+        const auto token = FindBearerToken(req);
+        if (!token) {
+            return {};
+        }
+        const auto player = FindTokenPlayer(*token, auth);
+        if (!player) {
+            return {};
+        }
+        return {player->map_id, std::nullopt};
+    }
+
+    return {};
+}
+
+std::optional<AuthorizedPlayer> ApiHandler::AuthorizeSocket(const StringRequest& req) const {
+    fs::path url;
+    try {
+        url = MakePathFromTarget(req);
+    }
+    catch (...) {
+        return std::nullopt;
+    }
+
+    // /api/v1/game/socket
+    auto it = url.begin();
+    auto end = url.end();
+    if (it == end || ++it == end || *it != "v1" || ++it == end || *it != "game" 
+        || ++it == end || *it != "socket" || ++it != end) {
+        return std::nullopt;
+    }
+
+    const auto token = FindBearerToken(req);
+    if (!token) {
+        return std::nullopt;
+    }
+
+    const auto owner = app_.FindTokenOwner(*token);
+    if (!owner) {
+        return std::nullopt;
+    }
+    return AuthorizedPlayer{owner->player_id, owner->map_id};
+}
+
+ApiResponse ApiHandler::HandleRequest(const StringRequest& req, AuthCache& auth, const RequestRoute& route) {
 
     fs::path url;
     try {
@@ -593,7 +1022,7 @@ StringResponse ApiHandler::HandleRequest(const StringRequest& req) {
 
     if (*it == "game") {
         ++it;
-        return HandleGameEndpoint(req, it, end);
+        return HandleGameEndpoint(req, it, end, auth, route);
     }
 
     return MakeBadRequest(req, "Bad Request");
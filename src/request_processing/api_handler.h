@@ -5,9 +5,18 @@
 #include "../metadata/loot_data.h"
 
 #include "make_response.h"
+#include "state_cache.h"
+#include "compression.h"
 
 #include <optional>
 #include <filesystem>
+#include <variant>
+#include <string>
+#include <unordered_map>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
 
 namespace http_handler {
 
@@ -16,6 +25,30 @@ namespace http = beast::http;
 
 using StringRequest = http::request<http::string_body>;
 using StringResponse = http::response<http::string_body>;
+using ApiResponse = std::variant<StringResponse, SharedResponse>;
+using AuthCache = http_server::AuthCache;
+
+// player identified by a bearer token
+struct AuthorizedPlayer {
+    application::Player::Id id;
+    model::Map::Id map_id;
+};
+
+// body of /api/v1/game/join
+struct JoinRequest {
+    std::string user_name;
+    model::Map::Id map_id;
+};
+
+// what an API request works with, found before it is dispatched
+struct RequestRoute {
+    // the map of the request (join, players, state, action), nullopt for requests without a map
+    // or with invalid credentials
+    std::optional<model::Map::Id> map_id;
+    // the body of a join request is parsed once, here, and handed to the handler;
+    // nullopt if it is not a valid join body
+    std::optional<JoinRequest> join;
+};
 
 class ApiHandler{
 public:
@@ -25,31 +58,83 @@ public:
         : app_{app}
         , loot_metadata_(loot_metadata)
         , auto_tick_enabled_{auto_tick_enabled} {
+        PrepareMapBodies();
     }
 
-    StringResponse HandleRequest(const StringRequest& req);
+    // auth caches the token of the connection between its requests,
+    // route is what RouteRequest found for the request
+    ApiResponse HandleRequest(const StringRequest& req, AuthCache& auth, const RequestRoute& route);
+
+    RequestRoute RouteRequest(const StringRequest& req, AuthCache& auth) const;
+
+    // /api/v1/game/socket with a valid token, other requests return nullopt
+    // and are answered by HandleRequest
+    std::optional<AuthorizedPlayer> AuthorizeSocket(const StringRequest& req) const;
+    // serialized state of the map, must be called on the executor of the map
+    StateCache::Snapshot GetStateSnapshot(const model::Map::Id& map_id) const;
+    // applies a {"move": "..."} command received over the socket, must be called on the executor
+    // of the player's map; returns false if the message is not a valid command
+    bool HandleSocketMessage(application::Player::Id player_id, std::string_view message);
 
 private:
     using PathIt = std::filesystem::path::const_iterator;
 
-    json::array GetAllMapsAsJsonArray() const;
+    // body of an immutable resource in every encoding and the entity tags of the encodings
+    struct PreparedBody {
+        EncodedBodies bodies;
+        EncodedETags etags;
+    };
+
+    // maps do not change after loading, so their responses are serialized and compressed once
+    void PrepareMapBodies();
+    static PreparedBody MakePreparedBody(std::string body, CompressionLevel level = CompressionLevel::Best);
+    std::string SerializeMapList() const;
+    SharedResponse MakePreparedResponse(const StringRequest& req, const PreparedBody& prepared) const;
 
-    StringResponse HandleMapsEndpoint(const StringRequest& req, PathIt it, PathIt end) const;
-    StringResponse HandleGameEndpoint(const StringRequest& req, PathIt it, PathIt end);
+    ApiResponse HandleMapsEndpoint(const StringRequest& req, PathIt it, PathIt end) const;
+    ApiResponse HandleGameEndpoint(const StringRequest& req, PathIt it, PathIt end, AuthCache& auth, 
+                                   const RequestRoute& route);
 
-    StringResponse HandleJoinGame(const StringRequest& request);
-    StringResponse HandleGetPlayers(const StringRequest& request) const;
-    StringResponse HandleGetGameState(const StringRequest& request) const;
-    StringResponse HandleMovePlayer(const StringRequest& request);
-    StringResponse HandleTick(const StringRequest& request);
-    StringResponse HandleGetRecords(const StringRequest& request) const;
+    static std::optional<JoinRequest> ParseJoinRequest(const StringRequest& request);
+    StringResponse HandleJoinGame(const StringRequest& request, const std::optional<JoinRequest>& join);
+    StringResponse HandleGetPlayers(const StringRequest& request, AuthCache& auth) const;
+    ApiResponse HandleGetGameState(const StringRequest& request, AuthCache& auth) const;
+    std::string SerializeGameState(const model::Map::Id& map_id) const;
+    StateCache::Snapshot GetBinaryStateSnapshot(const model::Map::Id& map_id) const;
+    // compressed variant of the snapshot cached next to it, nullptr if compression does not pay off
+    StateCache::Snapshot GetEncodedSnapshot(StateCache& cache, const model::Map::Id& map_id, 
+                                            const StateCache::Snapshot& snapshot, ContentEncoding encoding) const;
+    // /api/v1/game/state/delta?since=<seq>: players and loot changed after the given sequence
+    StringResponse HandleGetGameStateDelta(const StringRequest& request, AuthCache& auth) const;
+    ApiResponse HandleMovePlayer(const StringRequest& request, AuthCache& auth);
+    ApiResponse HandleTick(const StringRequest& request);
+    StringResponse HandleGameSocket(const StringRequest& request, AuthCache& auth) const;
+    ApiResponse HandleGetRecords(const StringRequest& request) const;
+    static std::string SerializeRecords(const std::vector<application::PlayerRecord>& records);
+    // page of the leaderboard serialized once per leaderboard version
+    std::shared_ptr<const PreparedBody> GetRecordsPage(std::size_t start, std::size_t max_items, 
+                                                       uint64_t version) const;
 
-    std::optional<StringResponse> CheckAuthorizationAndToken(const StringRequest& request, application::Player::Id& player_id) const;
+    std::optional<StringResponse> CheckAuthorizationAndToken(const StringRequest& request, AuthCache& auth, 
+                                                             application::Player::Id& player_id) const;
+    // owner of the token, looked up in the registry only if the cache of the connection does not have it
+    std::optional<AuthorizedPlayer> FindTokenPlayer(const application::Token& token, AuthCache& auth) const;
 
 private:
     application::Application& app_;
     const metadata::LootMetaPerMap& loot_metadata_;
     bool auto_tick_enabled_ = false; 
+    mutable StateCache state_cache_;
+    mutable StateCache binary_state_cache_;
+
+    PreparedBody map_list_body_;
+    std::unordered_map<model::Map::Id, PreparedBody, util::TaggedHasher<model::Map::Id>> map_bodies_;
+
+    // pages keyed by start and maxItems, all of them belong to records_version_
+    static constexpr std::size_t kMaxRecordsPages = 256;
+    mutable std::mutex records_mutex_;
+    mutable uint64_t records_version_ = 0;
+    mutable std::map<std::pair<std::size_t, std::size_t>, std::shared_ptr<const PreparedBody>> records_pages_;
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,97 @@
+#include "binary_state.h"
+
+#include <bit>
+
+namespace {
+
+constexpr uint8_t kFormatVersion = 1;
+
+class BinaryWriter {
+public:
+    explicit BinaryWriter(std::string& out)
+        : out_{out} {
+    }
+
+    void WriteByte(uint8_t value) {
+        out_.push_back(static_cast<char>(value));
+    }
+
+    void WriteVarint(uint64_t value) {
+        while (value >= 0x80) {
+            WriteByte(static_cast<uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        WriteByte(static_cast<uint8_t>(value));
+    }
+
+    void WriteFloat(double value) {
+        const uint32_t bits = std::bit_cast<uint32_t>(static_cast<float>(value));
+        for (int shift = 0; shift < 32; shift += 8) {
+            WriteByte(static_cast<uint8_t>(bits >> shift));
+        }
+    }
+
+private:
+    std::string& out_;
+};
+
+uint8_t DirectionCode(pos::Direction dir) {
+    switch (dir) {
+        case pos::Direction::NORTH:
+            return 0;
+        case pos::Direction::SOUTH:
+            return 1;
+        case pos::Direction::WEST:
+            return 2;
+        case pos::Direction::EAST:
+            return 3;
+    }
+    return 0;
+}
+
+} // namespace
+
+namespace http_handler {
+
+std::string EncodeBinaryGameState(const model::GameSession& session) {
+    const auto dogs = session.GetAllDogs();
+
+    std::string out;
+    // position, speed and direction take 17 bytes, ids, bags and scores a few more
+    out.reserve(16 + dogs.size() * 32);
+    BinaryWriter writer{out};
+
+    writer.WriteByte(kFormatVersion);
+    writer.WriteVarint(session.GetStateVersion());
+
+    // dog ids are the ids of their players
+    writer.WriteVarint(dogs.size());
+    for (const model::Dog& dog : dogs) {
+        const pos::Position& pos = dog.GetPosition();
+        writer.WriteVarint(static_cast<uint64_t>(dog.GetId()));
+        writer.WriteFloat(pos.coordinates_.x);
+        writer.WriteFloat(pos.coordinates_.y);
+        writer.WriteFloat(pos.velocity_.vx);
+        writer.WriteFloat(pos.velocity_.vy);
+        writer.WriteByte(DirectionCode(pos.direction_));
+
+        const auto& bag = dog.GetCollectedItems();
+        writer.WriteVarint(bag.size());
+        for (const auto& [item_id, info] : bag) {
+            writer.WriteVarint(item_id);
+            writer.WriteVarint(static_cast<uint64_t>(info.type));
+        }
+        writer.WriteVarint(static_cast<uint64_t>(dog.GetScore()));
+    }
+
+    writer.WriteVarint(session.GetLootItemNumber());
+    session.ForEachLootItem([&writer](const model::LootItem& item) {
+        writer.WriteVarint(static_cast<uint64_t>(item.info.type));
+        writer.WriteFloat(item.coordinate.x);
+        writer.WriteFloat(item.coordinate.y);
+    });
+
+    return out;
+}
+
+} // namespace http_handler
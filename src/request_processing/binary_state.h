@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "../game_model/game_session.h"
+
+namespace http_handler {
+
+// compact game state for clients that send "Accept: application/x-game-state"
+// all numbers are little-endian, varints are unsigned LEB128, floats are IEEE 754 binary32
+//
+//   u8     format version (1)
+//   varint state sequence, the same as "seq" of the delta endpoint
+//   varint player count, then for each player:
+//          varint id, f32 x, f32 y, f32 vx, f32 vy, u8 dir (0 U, 1 D, 2 L, 3 R),
+//          varint bag size, bag items as (varint id, varint type), varint score
+//   varint lost object count, then for each object:
+//          varint type, f32 x, f32 y
+//
+// lost objects are numbered by their position, like the keys of "lostObjects" in the JSON state
+std::string EncodeBinaryGameState(const model::GameSession& session);
+
+} // namespace http_handler
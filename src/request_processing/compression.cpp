@@ -0,0 +1,241 @@
+#include "compression.h"
+
+#include <zlib.h>
+#ifdef GAME_SERVER_WITH_BROTLI
+#include <brotli/encode.h>
+#endif
+
+#include <algorithm>
+#include <memory>
+
+namespace {
+
+using namespace http_handler;
+
+std::optional<std::string> CompressZlib(std::string_view data, bool gzip, CompressionLevel level) {
+    z_stream stream{};
+    const int zlib_level = (level == CompressionLevel::Best) ? Z_BEST_COMPRESSION : 4;
+    // 15 is the largest window, +16 asks for a gzip header instead of the zlib one
+    const int window_bits = gzip ? 15 + 16 : 15;
+    if (deflateInit2(&stream, zlib_level, Z_DEFLATED, window_bits, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return std::nullopt;
+    }
+
+    std::string out(deflateBound(&stream, static_cast<uLong>(data.size())), '\0');
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    stream.avail_in = static_cast<uInt>(data.size());
+    stream.next_out = reinterpret_cast<Bytef*>(out.data());
+    stream.avail_out = static_cast<uInt>(out.size());
+
+    const int result = deflate(&stream, Z_FINISH);
+    deflateEnd(&stream);
+    if (result != Z_STREAM_END) {
+        return std::nullopt;
+    }
+
+    out.resize(stream.total_out);
+    return out;
+}
+
+#ifdef GAME_SERVER_WITH_BROTLI
+std::optional<std::string> CompressBrotli(std::string_view data, CompressionLevel level) {
+    const int quality = (level == CompressionLevel::Best) ? BROTLI_MAX_QUALITY : 4;
+
+    size_t out_size = BrotliEncoderMaxCompressedSize(data.size());
+    std::string out(out_size, '\0');
+    const bool ok = BrotliEncoderCompress(quality, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_TEXT,
+                                          data.size(), reinterpret_cast<const uint8_t*>(data.data()),
+                                          &out_size, reinterpret_cast<uint8_t*>(out.data()));
+    if (!ok) {
+        return std::nullopt;
+    }
+
+    out.resize(out_size);
+    return out;
+}
+#endif
+
+std::string_view Trim(std::string_view s) {
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) {
+        s.remove_prefix(1);
+    }
+    while (!s.empty() && (s.back() == ' ' || s.back() == '\t')) {
+        s.remove_suffix(1);
+    }
+    return s;
+}
+
+// quality of "q=0.5", only the first three decimals matter
+int ParseQuality(std::string_view params) {
+    auto q = params.find("q=");
+    if (q == std::string_view::npos) {
+        return 1000;
+    }
+
+    std::string_view value = Trim(params.substr(q + 2));
+    value = value.substr(0, value.find(';'));
+    if (value.empty() || value.front() == '1') {
+        return 1000;
+    }
+
+    int quality = 0;
+    int scale = 100;
+    for (char ch : value.substr(std::min<size_t>(value.size(), 2))) {
+        if (ch < '0' || ch > '9' || scale == 0) {
+            break;
+        }
+        quality += (ch - '0') * scale;
+        scale /= 10;
+    }
+    return quality;
+}
+
+bool IsSupported(ContentEncoding encoding) {
+    return encoding != ContentEncoding::Brotli || IsBrotliSupported();
+}
+
+// precedence among encodings with equal quality, the best ratio first
+constexpr ContentEncoding kPreference[] = {
+    ContentEncoding::Brotli,
+    ContentEncoding::Gzip,
+    ContentEncoding::Deflate
+};
+
+} // namespace
+
+namespace http_handler {
+
+std::string_view ContentEncodingName(ContentEncoding encoding) {
+    switch (encoding) {
+        case ContentEncoding::Gzip:
+            return "gzip";
+        case ContentEncoding::Deflate:
+            return "deflate";
+        case ContentEncoding::Brotli:
+            return "br";
+        case ContentEncoding::Identity:
+            break;
+    }
+    return "identity";
+}
+
+ContentEncoding ChooseContentEncoding(const StringRequest& request) {
+    auto it = request.find(http::field::accept_encoding);
+    if (it == request.end()) {
+        return ContentEncoding::Identity;
+    }
+
+    // -1 means not listed, "*" sets the quality of every unlisted coding
+    std::array<int, kContentEncodingCount> quality;
+    quality.fill(-1);
+    int wildcard = -1;
+
+    std::string_view header = it->value();
+    while (!header.empty()) {
+        auto comma = header.find(',');
+        std::string_view coding = header.substr(0, comma);
+        header = (comma == std::string_view::npos) ? std::string_view{} : header.substr(comma + 1);
+
+        std::string_view params;
+        if (auto semicolon = coding.find(';'); semicolon != std::string_view::npos) {
+            params = coding.substr(semicolon + 1);
+            coding = coding.substr(0, semicolon);
+        }
+        coding = Trim(coding);
+
+        const int q = ParseQuality(params);
+        if (coding == "*") {
+            wildcard = q;
+            continue;
+        }
+        for (ContentEncoding encoding : kPreference) {
+            if (coding == ContentEncodingName(encoding)) {
+                quality[static_cast<std::size_t>(encoding)] = q;
+            }
+        }
+    }
+
+    ContentEncoding best = ContentEncoding::Identity;
+    int best_quality = 0;
+    for (ContentEncoding encoding : kPreference) {
+        if (!IsSupported(encoding)) {
+            continue;
+        }
+        int q = quality[static_cast<std::size_t>(encoding)];
+        if (q < 0) {
+            q = wildcard;
+        }
+        if (q > best_quality) {
+            best = encoding;
+            best_quality = q;
+        }
+    }
+    return best;
+}
+
+std::optional<std::string> Compress(std::string_view data, ContentEncoding encoding, CompressionLevel level) {
+    std::optional<std::string> result;
+    switch (encoding) {
+        case ContentEncoding::Gzip:
+            result = CompressZlib(data, true, level);
+            break;
+        case ContentEncoding::Deflate:
+            result = CompressZlib(data, false, level);
+            break;
+        case ContentEncoding::Brotli:
+#ifdef GAME_SERVER_WITH_BROTLI
+            result = CompressBrotli(data, level);
+#endif
+            break;
+        case ContentEncoding::Identity:
+            break;
+    }
+
+    if (result && result->size() >= data.size()) {
+        return std::nullopt;
+    }
+    return result;
+}
+
+EncodedBodies CompressAll(SharedBuffer body, CompressionLevel level) {
+    EncodedBodies bodies;
+    if (body && body->size() >= kMinCompressedSize) {
+        for (ContentEncoding encoding : kPreference) {
+            if (auto compressed = Compress(*body, encoding, level)) {
+                bodies[static_cast<std::size_t>(encoding)] = std::make_shared<const std::string>(std::move(*compressed));
+            }
+        }
+    }
+    bodies[static_cast<std::size_t>(ContentEncoding::Identity)] = std::move(body);
+    return bodies;
+}
+
+EncodedETags MakeEncodedETags(std::string_view etag) {
+    EncodedETags etags;
+    for (std::size_t i = 0; i < kContentEncodingCount; ++i) {
+        const auto encoding = static_cast<ContentEncoding>(i);
+        if (encoding == ContentEncoding::Identity || etag.size() < 2) {
+            etags[i] = etag;
+            continue;
+        }
+        // the suffix goes inside the quotes
+        etags[i].append(etag.substr(0, etag.size() - 1)).append("-").append(ContentEncodingName(encoding)).append("\"");
+    }
+    return etags;
+}
+
+void CompressResponse(StringResponse& response, ContentEncoding encoding) {
+    if (encoding == ContentEncoding::Identity || response.body().size() < kMinCompressedSize
+        || response.find(http::field::content_encoding) != response.end()) {
+        return;
+    }
+
+    if (auto compressed = Compress(response.body(), encoding, CompressionLevel::Fast)) {
+        response.body() = std::move(*compressed);
+        response.set(http::field::content_encoding, ContentEncodingName(encoding));
+        response.content_length(response.body().size());
+        AddVary(response, "Accept-Encoding");
+    }
+}
+
+} // namespace http_handler
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "make_response.h"
+
+namespace http_handler {
+
+// brotli is compiled in when GAME_SERVER_WITH_BROTLI is defined and libbrotlienc is linked
+enum class ContentEncoding : std::size_t {
+    Identity,
+    Gzip,
+    Deflate,
+    Brotli
+};
+
+inline constexpr std::size_t kContentEncodingCount = 4;
+
+// smaller bodies fit into a couple of packets anyway
+inline constexpr std::size_t kMinCompressedSize = 1024;
+
+enum class CompressionLevel {
+    // for bodies compressed per request
+    Fast,
+    // for bodies compressed once and served many times
+    Best
+};
+
+constexpr bool IsBrotliSupported() {
+#ifdef GAME_SERVER_WITH_BROTLI
+    return true;
+#else
+    return false;
+#endif
+}
+
+// value of the Content-Encoding header
+std::string_view ContentEncodingName(ContentEncoding encoding);
+
+// the supported encoding with the highest quality in Accept-Encoding, Identity if none
+ContentEncoding ChooseContentEncoding(const StringRequest& request);
+
+// nullopt if the encoding is not supported or the result is not smaller than the data
+std::optional<std::string> Compress(std::string_view data, ContentEncoding encoding, CompressionLevel level);
+
+// body of a resource compressed with every supported encoding, variants that did not
+// pay off stay empty and Identity is always set
+using EncodedBodies = std::array<SharedBuffer, kContentEncodingCount>;
+EncodedBodies CompressAll(SharedBuffer body, CompressionLevel level);
+
+// every encoding is a separate representation with its own strong tag: "tag", "tag-gzip", ...
+using EncodedETags = std::array<std::string, kContentEncodingCount>;
+EncodedETags MakeEncodedETags(std::string_view etag);
+
+// appends the header to Vary
+template <typename Response>
+void AddVary(Response& response, std::string_view header) {
+    auto it = response.find(http::field::vary);
+    if (it == response.end()) {
+        response.set(http::field::vary, header);
+        return;
+    }
+    std::string vary{it->value()};
+    vary.append(", ").append(header);
+    response.set(http::field::vary, vary);
+}
+
+// compresses a body built for this response if it has at least kMinCompressedSize bytes
+// and is not encoded yet; shared bodies are compressed once by their owners instead
+void CompressResponse(StringResponse& response, ContentEncoding encoding);
+
+} // namespace http_handler
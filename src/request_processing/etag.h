@@ -0,0 +1,155 @@
+#pragma once
+
+#define BOOST_BEAST_USE_STD_STRING_VIEW
+
+#include <boost/beast/http.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace http_handler {
+
+namespace beast = boost::beast;
+namespace http = beast::http;
+
+// strong entity tag derived from the content, stable between server runs
+inline std::string MakeStrongETag(std::string_view content) {
+    // 64-bit FNV-1a
+    uint64_t hash = 14695981039346656037ull;
+    for (char ch : content) {
+        hash ^= static_cast<unsigned char>(ch);
+        hash *= 1099511628211ull;
+    }
+
+    static constexpr char kHex[] = "0123456789abcdef";
+    std::string etag(18, '"');
+    for (int i = 16; i > 0; --i) {
+        etag[i] = kHex[hash & 0xF];
+        hash >>= 4;
+    }
+    return etag;
+}
+
+// true if If-None-Match of the request lists the tag or "*"
+// tags are compared weakly, as required for GET and HEAD
+template <typename Body, typename Fields>
+bool MatchesIfNoneMatch(const http::request<Body, Fields>& request, std::string_view etag) {
+    auto it = request.find(http::field::if_none_match);
+    if (it == request.end()) {
+        return false;
+    }
+
+    std::string_view header = it->value();
+    while (!header.empty()) {
+        auto comma = header.find(',');
+        std::string_view tag = header.substr(0, comma);
+        header = (comma == std::string_view::npos) ? std::string_view{} : header.substr(comma + 1);
+
+        while (!tag.empty() && tag.front() == ' ') {
+            tag.remove_prefix(1);
+        }
+        while (!tag.empty() && tag.back() == ' ') {
+            tag.remove_suffix(1);
+        }
+        if (tag.starts_with("W/")) {
+            tag.remove_prefix(2);
+        }
+        if (tag == "*" || tag == etag) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// IMF-fixdate of Last-Modified, e.g. "Sun, 06 Nov 1994 08:49:37 GMT"
+inline std::string FormatHttpDate(std::chrono::sys_seconds time) {
+    using namespace std::chrono;
+    static constexpr std::string_view kWeekdays[] = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
+    static constexpr std::string_view kMonths[] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun", 
+                                                   "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+
+    const sys_days days = floor<std::chrono::days>(time);
+    const year_month_day date{days};
+    const hh_mm_ss clock{time - days};
+
+    auto two_digits = [](std::string& out, unsigned value) {
+        out.push_back(static_cast<char>('0' + value / 10 % 10));
+        out.push_back(static_cast<char>('0' + value % 10));
+    };
+
+    std::string result;
+    result.reserve(29);
+    result.append(kWeekdays[weekday{days}.c_encoding()]).append(", ");
+    two_digits(result, static_cast<unsigned>(date.day()));
+    result.append(" ").append(kMonths[static_cast<unsigned>(date.month()) - 1]).append(" ");
+    two_digits(result, static_cast<unsigned>(static_cast<int>(date.year()) / 100));
+    two_digits(result, static_cast<unsigned>(static_cast<int>(date.year()) % 100));
+    result.push_back(' ');
+    two_digits(result, static_cast<unsigned>(clock.hours().count()));
+    result.push_back(':');
+    two_digits(result, static_cast<unsigned>(clock.minutes().count()));
+    result.push_back(':');
+    two_digits(result, static_cast<unsigned>(clock.seconds().count()));
+    result.append(" GMT");
+    return result;
+}
+
+// parses an IMF-fixdate, the obsolete RFC 850 and asctime formats are not accepted
+inline std::optional<std::chrono::sys_seconds> ParseHttpDate(std::string_view text) {
+    using namespace std::chrono;
+    static constexpr std::string_view kMonths = "JanFebMarAprMayJunJulAugSepOctNovDec";
+
+    // "Sun, 06 Nov 1994 08:49:37 GMT"
+    if (text.size() != 29 || text.substr(3, 2) != ", " || text.substr(25) != " GMT") {
+        return std::nullopt;
+    }
+
+    auto number = [text](size_t pos, size_t count) -> std::optional<int> {
+        int value = 0;
+        for (char ch : text.substr(pos, count)) {
+            if (ch < '0' || ch > '9') {
+                return std::nullopt;
+            }
+            value = value * 10 + (ch - '0');
+        }
+        return value;
+    };
+
+    const auto month_pos = kMonths.find(text.substr(8, 3));
+    const auto d = number(5, 2);
+    const auto y = number(12, 4);
+    const auto h = number(17, 2);
+    const auto m = number(20, 2);
+    const auto s = number(23, 2);
+    if (month_pos == std::string_view::npos || month_pos % 3 != 0 || !d || !y || !h || !m || !s 
+        || *h > 23 || *m > 59 || *s > 60) {
+        return std::nullopt;
+    }
+
+    const year_month_day date{year{*y}, month{static_cast<unsigned>(month_pos / 3 + 1)}, 
+                              day{static_cast<unsigned>(*d)}};
+    if (!date.ok()) {
+        return std::nullopt;
+    }
+    return sys_days{date} + hours{*h} + minutes{*m} + seconds{*s};
+}
+
+// true if If-Modified-Since of the request is not older than the modification time;
+// the header is ignored when If-None-Match is present
+template <typename Body, typename Fields>
+bool IsNotModifiedSince(const http::request<Body, Fields>& request, std::chrono::sys_seconds modified) {
+    if (request.find(http::field::if_none_match) != request.end()) {
+        return false;
+    }
+    auto it = request.find(http::field::if_modified_since);
+    if (it == request.end()) {
+        return false;
+    }
+    const auto since = ParseHttpDate(it->value());
+    return since && modified <= *since;
+}
+
+} // namespace http_handler
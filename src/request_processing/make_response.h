@@ -5,8 +5,12 @@
 #include <boost/beast.hpp>
 #include <boost/json.hpp>
 
+#include <memory>
+#include <string>
 #include <string_view>
 
+#include "../server/shared_body.h"
+
 namespace http_handler {
 
 namespace json = boost::json;
@@ -15,6 +19,9 @@ namespace http = beast::http;
 
 using StringResponse = http::response<http::string_body>;
 using StringRequest = http::request<http::string_body>;
+using SharedResponse = http::response<http_server::SharedBody>;
+// immutable body shared by responses, caches and websocket frames
+using SharedBuffer = http_server::SharedBody::value_type;
 
 using namespace std::string_view_literals;
 
@@ -27,6 +34,8 @@ struct ContentType {
 
     constexpr static std::string_view JSON = "application/json"sv;
     constexpr static std::string_view XML = "application/xml"sv;
+    // compact binary game state, see binary_state.h
+    constexpr static std::string_view GAME_STATE = "application/x-game-state"sv;
 
     constexpr static std::string_view IMAGE_PNG = "image/png"sv;
     constexpr static std::string_view IMAGE_JPEG = "image/jpeg"sv;
@@ -56,6 +65,40 @@ inline StringResponse MakeStringResponse(http::status status, std::string_view b
     return response; 
 }
 
+// takes over a JSON body that was written for this response
+inline StringResponse MakeJsonResponse(http::status status, std::string&& body, unsigned http_version, 
+                                       bool keep_alive) {
+    StringResponse response(status, http_version);
+    response.set(http::field::content_type, ContentType::JSON);
+    response.set(http::field::cache_control, "no-cache");
+    response.content_length(body.size());
+    response.body() = std::move(body);
+    response.keep_alive(keep_alive);
+    return response; 
+}
+
+// sends the shared buffer without copying it
+inline SharedResponse MakeSharedResponse(http::status status, SharedBuffer body, unsigned http_version,
+                                         bool keep_alive, std::string_view content_type = ContentType::JSON) {
+    SharedResponse response(status, http_version);
+    response.set(http::field::content_type, content_type);
+    response.content_length(http_server::SharedBody::size(body));
+    response.body() = std::move(body);
+    response.keep_alive(keep_alive);
+
+    if (content_type == ContentType::JSON) {
+        response.set(http::field::cache_control, "no-cache");
+    }
+
+    return response;
+}
+
+// "{}" returned by the action endpoints
+inline const SharedBuffer& EmptyJsonObject() {
+    static const SharedBuffer body = std::make_shared<const std::string>("{}");
+    return body;
+}
+
 inline StringResponse MakeErrorResponse(http::status status, std::string code, std::string message, 
                                 const StringRequest& req, std::string_view content_type = ContentType::JSON) {
     json::object bad_response;
@@ -1,47 +1,45 @@
 #include "request_handler.h"
 #include "make_response.h"
 #include "path_handler.h"
+#include "etag.h"
 
 namespace {
     namespace json = boost::json;
     namespace fs = std::filesystem;
     using namespace http_handler;
 
-    std::string_view DetectMime(const fs::path& path) {
-        auto ext = path.extension().string();
-        std::transform(ext.begin(), ext.end(), ext.begin(),
-                   [](unsigned char c){ return static_cast<char>(std::tolower(c)); });
-
-        struct ExtMime {
-            std::string_view ext;
-            std::string_view mime;
-        };
-
-        static constexpr ExtMime table[] = {
-            {".htm",  ContentType::TEXT_HTML},
-            {".html", ContentType::TEXT_HTML},
-            {".css",  ContentType::TEXT_CSS},
-            {".txt",  ContentType::TEXT_PLAIN},
-            {".js",   ContentType::TEXT_JAVA},
-            {".json", ContentType::JSON},
-            {".png",  ContentType::IMAGE_PNG},
-            {".jpg",  ContentType::IMAGE_JPEG},
-            {".jpeg", ContentType::IMAGE_JPEG},
-            {".gif",  ContentType::IMAGE_GIF},
-            {".bmp",  ContentType::IMAGE_BMP},
-            {".ico",  ContentType::IMAGE_ICO},
-            {".svg",  ContentType::IMAGE_SVG},
-            {".svgz", ContentType::IMAGE_SVG},
-            {".mp3",  ContentType::AUDIO_MP3},
-        };
-
-        for (const auto& [e, m] : table) {
-            if (ext == e) {
-                return m;
+    // answer from memory, 304 if the client has the same representation
+    SharedResponse MakeCachedFileResponse(const StringRequest& req, const StaticFileCache::File& file) {
+        auto encoding = file.compressible ? ChooseContentEncoding(req) : ContentEncoding::Identity;
+        if (!file.bodies[static_cast<size_t>(encoding)]) {
+            encoding = ContentEncoding::Identity;
+        }
+        const auto index = static_cast<size_t>(encoding);
+
+        SharedResponse res;
+        if (MatchesIfNoneMatch(req, file.etags[index]) || IsNotModifiedSince(req, file.modified)) {
+            res = SharedResponse(http::status::not_modified, req.version());
+            res.keep_alive(req.keep_alive());
+        }
+        else {
+            res = MakeSharedResponse(http::status::ok, file.bodies[index], req.version(), req.keep_alive(), 
+                                     file.content_type);
+            if (encoding != ContentEncoding::Identity) {
+                res.set(http::field::content_encoding, ContentEncodingName(encoding));
             }
         }
 
-        return ContentType::UNKNOWN;
+        res.set(http::field::etag, file.etags[index]);
+        res.set(http::field::last_modified, file.last_modified);
+        // the browser revalidates and gets 304 while the file is unchanged
+        res.set(http::field::cache_control, "no-cache");
+        if (file.compressible) {
+            res.set(http::field::vary, "Accept-Encoding");
+        }
+        if (req.method() == http::verb::head) {
+            res.body().reset();
+        }
+        return res;
     }
 
 } // namespace
@@ -61,6 +59,13 @@ namespace http_handler {
                                     "badRequest", "URL is not correct", req, ContentType::TEXT_PLAIN);
         }
 
+        // cached files are answered without touching the disk
+        if (req.method() == http::verb::get || req.method() == http::verb::head) {
+            if (StaticFileCache::FilePtr file = static_files_.Find(url)) {
+                return MakeCachedFileResponse(req, *file);
+            }
+        }
+
         fs::path abs_path = fs::weakly_canonical(root_path_ / url);
         if (!IsSubPath(abs_path, root_path_)) {
             return MakeErrorResponse(http::status::bad_request, 
@@ -76,12 +81,16 @@ namespace http_handler {
             abs_path = fs::weakly_canonical(root_path_ / "index.html");
         }
 
+        const bool compressible = IsCompressibleFile(abs_path);
         switch (req.method()) {
             // return the head as string response
             case http::verb::head: {
                 const auto file_size = fs::file_size(abs_path);
                 StringResponse res = MakeStringResponse(http::status::ok, "", req.version(), req.keep_alive(), DetectMime(abs_path));
                 res.content_length(file_size);
+                if (compressible) {
+                    res.set(http::field::vary, "Accept-Encoding");
+                }
                 return res;
             }
             // return a file
@@ -89,6 +98,9 @@ namespace http_handler {
                 FileResponse res{http::status::ok, req.version()};
                 res.keep_alive(req.keep_alive());
                 res.set(http::field::content_type, DetectMime(abs_path));
+                if (compressible) {
+                    res.set(http::field::vary, "Accept-Encoding");
+                }
 
                 http::file_body::value_type file;
                 boost::system::error_code ec;
@@ -117,4 +129,50 @@ namespace http_handler {
         } 
     }
 
+    bool RequestHandler::Upgrade(StringRequest& request, beast::tcp_stream& stream) {
+        const std::optional<AuthorizedPlayer> player = api_handler_.AuthorizeSocket(request);
+        if (!player) {
+            return false;
+        }
+
+        auto session = std::make_shared<http_server::WebSocketSession>(std::move(stream),
+            [self = shared_from_this(), player = *player](std::string&& message) {
+                self->HandleSocketMessage(player, std::move(message));
+            });
+
+        // the first frame is pushed after the next tick of the map
+        subscribers_.Subscribe(player->map_id, player->id, session);
+        session->Run(std::move(request));
+        return true;
+    }
+
+    void RequestHandler::PublishState(const model::Map::Id& map_id) {
+        if (!subscribers_.HasSubscribers(map_id)) {
+            return;
+        }
+
+        net::dispatch(strands_.GetStrandForMap(map_id), [self = shared_from_this(), map_id] {
+            StateCache::Snapshot state;
+            {
+                const auto access = self->application_.LockMapAccess();
+                state = self->api_handler_.GetStateSnapshot(map_id);
+            }
+            // sockets of revoked tokens are closed, like /state answers unknownToken over HTTP
+            const uint64_t token_generation = self->application_.GetTokenGeneration();
+            self->subscribers_.Publish(map_id, state, token_generation, [&self](application::Player::Id player_id) {
+                return self->application_.FindPlayerById(player_id) != nullptr;
+            });
+        });
+    }
+
+    void RequestHandler::HandleSocketMessage(const AuthorizedPlayer& player, std::string&& message) {
+        // commands change the map, so they run on its strand like the HTTP action requests;
+        // invalid commands are ignored
+        net::dispatch(strands_.GetStrandForMap(player.map_id), 
+            [self = shared_from_this(), player_id = player.id, message = std::move(message)] {
+                const auto access = self->application_.LockMapAccess();
+                self->api_handler_.HandleSocketMessage(player_id, message);
+            });
+    }
+
 }  // namespace http_handler
@@ -1,8 +1,12 @@
 #pragma once
 #include "../server/http_server.h"
+#include "../server/map_strands.h"
 #include "../app/application.h"
 #include "../metadata/loot_data.h"
 #include "api_handler.h"
+#include "state_subscribers.h"
+#include "compression.h"
+#include "static_file_cache.h"
 
 #include <boost/beast.hpp>
 #include <boost/json.hpp>
@@ -26,36 +30,59 @@ using namespace std::literals;
 using StringRequest = http::request<http::string_body>;
 using StringResponse = http::response<http::string_body>;
 using FileResponse = http::response<http::file_body>;
-using VariantResponse = std::variant<StringResponse, FileResponse>;
+using VariantResponse = std::variant<StringResponse, FileResponse, SharedResponse>;
 
 class RequestHandler : public std::enable_shared_from_this<RequestHandler> {
 public:
-    using Strand = net::strand<net::io_context::executor_type>;
-
     explicit RequestHandler(application::Application& application, 
                             const metadata::LootMetaPerMap& loot_metadata,
                             const std::filesystem::path& root_path, 
-                            Strand strand, bool auto_tick_enabled)
+                            const server::MapStrands& strands, bool auto_tick_enabled)
         : application_{application}
         , loot_metadata_(loot_metadata)
         , root_path_{std::filesystem::weakly_canonical(root_path)}
         , api_handler_{application, loot_metadata, auto_tick_enabled}
-        , strand_{strand} {
+        , strands_{strands}
+        , static_files_{root_path_} {
+        // the watch is set first, so nothing changed while loading is missed
+        static_files_.Watch();
+        static_files_.Load();
     }
 
     RequestHandler(const RequestHandler&) = delete;
     RequestHandler& operator=(const RequestHandler&) = delete;
 
+    // auth is the credentials cache of the connection, it outlives send
     template <typename Body, typename Allocator, typename Send>
-    void operator()(http::request<Body, http::basic_fields<Allocator>>&& req, Send&& send) {
+    void operator()(http::request<Body, http::basic_fields<Allocator>>&& req, http_server::AuthCache& auth, 
+                    Send&& send) {
         const auto target = req.target();
         const bool is_api = target.size() >= 4 && target.substr(0, 4) == "/api"sv;
 
         if (is_api) {
-            // Dispatch to the strand to ensure thread safety
-            net::dispatch(strand_,
-                [self = shared_from_this(), req = std::move(req), send = std::forward<Send>(send)]() mutable {
-                    VariantResponse resp = self->api_handler_.HandleRequest(std::move(req));
+            // Requests of a map are executed on the strand of this map,
+            // the rest of the API is executed on the common strand
+            RequestRoute route = api_handler_.RouteRequest(req, auth);
+            const bool map_bound = route.map_id.has_value();
+            auto strand = map_bound ? strands_.GetStrandForMap(*route.map_id) : strands_.GetCommonStrand();
+
+            net::dispatch(strand,
+                [self = shared_from_this(), map_bound, route = std::move(route), req = std::move(req), &auth, 
+                 send = std::forward<Send>(send)]() mutable {
+                    ApiResponse resp;
+                    {
+                        application::Application::MapAccess access;
+                        if (map_bound) {
+                            access = self->application_.LockMapAccess();
+                        }
+                        resp = self->api_handler_.HandleRequest(req, auth, route);
+                    }
+
+                    // large bodies built for this request are compressed on the fly,
+                    // after the lock is released so barrier ticks and state saves do not wait for it
+                    if (auto* string_resp = std::get_if<StringResponse>(&resp)) {
+                        CompressResponse(*string_resp, ChooseContentEncoding(req));
+                    }
 
                     std::visit(
                         [&send](auto&& concrete_resp) {
@@ -78,8 +105,16 @@ public:
         }
     }
 
+    // takes over the stream of an authorized /api/v1/game/socket upgrade request,
+    // returns false for other requests so they are answered over HTTP
+    bool Upgrade(StringRequest& request, beast::tcp_stream& stream);
+
+    // pushes the state of the map to its websocket subscribers
+    void PublishState(const model::Map::Id& map_id);
+
 private:
     VariantResponse HandleFileRequest(const StringRequest& request);
+    void HandleSocketMessage(const AuthorizedPlayer& player, std::string&& message);
 
 private:
     application::Application& application_;
@@ -87,7 +122,9 @@ private:
     ApiHandler api_handler_;
     const metadata::LootMetaPerMap& loot_metadata_;
 
-    Strand strand_;
+    const server::MapStrands& strands_;
+    StateSubscribers subscribers_;
+    StaticFileCache static_files_;
 };
 
 }  // namespace http_handler
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "../game_model/map.h"
+#include "../detail/tagged.h"
+#include "make_response.h"
+
+namespace http_handler {
+
+// serialized game state of each map, shared by all requests until the map state version changes
+// the first request after a change rebuilds the snapshot, the rest reuse it
+class StateCache {
+public:
+    using Snapshot = SharedBuffer;
+
+    // a state may have several representations, e.g. compressed ones;
+    // all of them are dropped together when the version changes
+    static constexpr size_t kMaxVariants = 4;
+
+    template <typename Build>
+    Snapshot Get(const model::Map::Id& map_id, uint64_t version, Build&& build, size_t variant = 0) {
+        Entry& entry = GetEntry(map_id);
+
+        std::lock_guard lock{entry.mutex};
+        if (entry.version != version) {
+            entry.variants.fill(nullptr);
+            entry.version = version;
+        }
+
+        Snapshot& snapshot = entry.variants.at(variant);
+        if (!snapshot) {
+            snapshot = std::make_shared<const std::string>(build());
+        }
+        return snapshot;
+    }
+
+private:
+    struct Entry {
+        std::mutex mutex;
+        uint64_t version = 0;
+        std::array<Snapshot, kMaxVariants> variants;
+    };
+
+    Entry& GetEntry(const model::Map::Id& map_id) {
+        // references to unordered_map values stay valid on insertion
+        std::lock_guard lock{entries_mutex_};
+        return entries_[map_id];
+    }
+
+    std::mutex entries_mutex_;
+    std::unordered_map<model::Map::Id, Entry, util::TaggedHasher<model::Map::Id>> entries_;
+};
+
+} // namespace http_handler
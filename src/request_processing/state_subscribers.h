@@ -0,0 +1,97 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include "../app/player.h"
+#include "../game_model/map.h"
+#include "../detail/tagged.h"
+#include "../server/websocket_session.h"
+#include "state_cache.h"
+
+namespace http_handler {
+
+// websocket sessions subscribed to the state of their map
+// sessions are held weakly and forgotten once they are closed;
+// sessions of players that are gone, e.g. retired, are closed on the next publish
+class StateSubscribers {
+public:
+    using Session = std::weak_ptr<http_server::WebSocketSession>;
+
+    void Subscribe(const model::Map::Id& map_id, application::Player::Id player_id, Session session) {
+        std::lock_guard lock{mutex_};
+        auto& map_subscribers = subscribers_[map_id];
+        map_subscribers.list.push_back(Subscriber{std::move(session), player_id});
+        // the token may have been revoked after it was checked, so the next publish checks again
+        map_subscribers.checked_generation.reset();
+    }
+
+    bool HasSubscribers(const model::Map::Id& map_id) const {
+        std::lock_guard lock{mutex_};
+        auto it = subscribers_.find(map_id);
+        return it != subscribers_.end() && !it->second.list.empty();
+    }
+
+    // pushes the snapshot to every open session of the map;
+    // players are looked up with is_active only when token_generation differs from the previous publish,
+    // it must be read before the lookups so a revocation in between is seen next time
+    template <typename IsActive>
+    void Publish(const model::Map::Id& map_id, const StateCache::Snapshot& snapshot, 
+                 uint64_t token_generation, IsActive&& is_active) {
+        std::vector<std::shared_ptr<http_server::WebSocketSession>> sessions;
+        std::vector<std::shared_ptr<http_server::WebSocketSession>> revoked;
+        {
+            std::lock_guard lock{mutex_};
+            auto it = subscribers_.find(map_id);
+            if (it == subscribers_.end()) {
+                return;
+            }
+
+            auto& map_subscribers = it->second;
+            const bool check_players = map_subscribers.checked_generation != token_generation;
+            map_subscribers.checked_generation = token_generation;
+
+            sessions.reserve(map_subscribers.list.size());
+            std::erase_if(map_subscribers.list, [&](const Subscriber& subscriber) {
+                auto session = subscriber.session.lock();
+                if (!session) {
+                    return true;
+                }
+                if (check_players && !is_active(subscriber.player_id)) {
+                    revoked.push_back(std::move(session));
+                    return true;
+                }
+                sessions.push_back(std::move(session));
+                return false;
+            });
+        }
+
+        for (const auto& session : sessions) {
+            session->Push(snapshot);
+        }
+        for (const auto& session : revoked) {
+            session->Close(http_server::websocket::close_reason{http_server::websocket::close_code::policy_error, 
+                                                                "unknownToken"});
+        }
+    }
+
+private:
+    struct Subscriber {
+        Session session;
+        application::Player::Id player_id;
+    };
+
+    struct MapSubscribers {
+        std::vector<Subscriber> list;
+        // every player of the list was checked while the token generation had this value
+        std::optional<uint64_t> checked_generation;
+    };
+
+    mutable std::mutex mutex_;
+    std::unordered_map<model::Map::Id, MapSubscribers, util::TaggedHasher<model::Map::Id>> subscribers_;
+};
+
+} // namespace http_handler
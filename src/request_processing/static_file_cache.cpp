@@ -0,0 +1,413 @@
+#include "static_file_cache.h"
+#include "etag.h"
+#include "make_response.h"
+#include "path_handler.h"
+
+#ifdef __linux__
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/posix/stream_descriptor.hpp>
+#include <sys/inotify.h>
+#include <thread>
+#endif
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+
+namespace {
+
+namespace fs = std::filesystem;
+using namespace http_handler;
+
+std::optional<std::string> ReadFile(const fs::path& path) {
+    std::ifstream file{path, std::ios::binary};
+    if (!file) {
+        return std::nullopt;
+    }
+    std::string content{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+    if (!file.good() && !file.eof()) {
+        return std::nullopt;
+    }
+    return content;
+}
+
+std::uintmax_t BodiesSize(const EncodedBodies& bodies) {
+    std::uintmax_t size = 0;
+    for (const auto& body : bodies) {
+        size += http_server::SharedBody::size(body);
+    }
+    return size;
+}
+
+} // namespace
+
+namespace http_handler {
+
+std::string_view DetectMime(const fs::path& path) {
+    auto ext = path.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(),
+               [](unsigned char c){ return static_cast<char>(std::tolower(c)); });
+
+    struct ExtMime {
+        std::string_view ext;
+        std::string_view mime;
+    };
+
+    static constexpr ExtMime table[] = {
+        {".htm",  ContentType::TEXT_HTML},
+        {".html", ContentType::TEXT_HTML},
+        {".css",  ContentType::TEXT_CSS},
+        {".txt",  ContentType::TEXT_PLAIN},
+        {".js",   ContentType::TEXT_JAVA},
+        {".json", ContentType::JSON},
+        {".png",  ContentType::IMAGE_PNG},
+        {".jpg",  ContentType::IMAGE_JPEG},
+        {".jpeg", ContentType::IMAGE_JPEG},
+        {".gif",  ContentType::IMAGE_GIF},
+        {".bmp",  ContentType::IMAGE_BMP},
+        {".ico",  ContentType::IMAGE_ICO},
+        {".svg",  ContentType::IMAGE_SVG},
+        {".svgz", ContentType::IMAGE_SVG},
+        {".mp3",  ContentType::AUDIO_MP3},
+    };
+
+    for (const auto& [e, m] : table) {
+        if (ext == e) {
+            return m;
+        }
+    }
+
+    return ContentType::UNKNOWN;
+}
+
+bool IsCompressibleFile(const fs::path& path) {
+    const std::string_view mime = DetectMime(path);
+    if (mime == ContentType::IMAGE_SVG) {
+        return path.extension() != ".svgz";
+    }
+    return mime == ContentType::TEXT_HTML || mime == ContentType::TEXT_CSS || mime == ContentType::TEXT_PLAIN
+        || mime == ContentType::TEXT_JAVA || mime == ContentType::JSON || mime == ContentType::XML;
+}
+
+#ifdef __linux__
+
+namespace net = boost::asio;
+
+// inotify watches of the root and all its subdirectories;
+// the events are handled one after another on the own thread of the watcher
+class StaticFileCache::Watcher {
+public:
+    Watcher(StaticFileCache& cache, int fd)
+        : stream_{ioc_, fd}
+        , cache_{cache} {
+    }
+
+    ~Watcher() {
+        ioc_.stop();
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+    }
+
+    // events that came after the watches were added wait in the descriptor until then
+    void Start() {
+        if (thread_.joinable()) {
+            return;
+        }
+        Read();
+        thread_ = std::thread{[this] {
+            ioc_.run();
+        }};
+    }
+
+    // watches the directory and everything below it
+    bool AddWatch(const fs::path& directory) {
+        constexpr uint32_t kMask = IN_CLOSE_WRITE | IN_MODIFY | IN_ATTRIB | IN_CREATE | IN_DELETE
+                                 | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR | IN_DONT_FOLLOW;
+
+        const int wd = inotify_add_watch(stream_.native_handle(), directory.c_str(), kMask);
+        if (wd < 0) {
+            return false;
+        }
+        directories_[wd] = directory;
+
+        std::error_code ec;
+        for (fs::recursive_directory_iterator it{directory, ec}, end; !ec && it != end; it.increment(ec)) {
+            if (!it->is_symlink(ec) && it->is_directory(ec)) {
+                if (const int sub_wd = inotify_add_watch(stream_.native_handle(), it->path().c_str(), kMask); sub_wd >= 0) {
+                    directories_[sub_wd] = it->path();
+                }
+            }
+        }
+        return true;
+    }
+
+private:
+    void Read() {
+        stream_.async_read_some(net::buffer(buffer_), [this](const boost::system::error_code& ec, size_t size) {
+            OnRead(ec, size);
+        });
+    }
+
+    void OnRead(const boost::system::error_code& ec, size_t size) {
+        if (ec) {
+            // changes are not seen any more, the cache falls back to checking files on lookup
+            cache_.watching_ = false;
+            return;
+        }
+
+        for (size_t offset = 0; offset + sizeof(inotify_event) <= size;) {
+            inotify_event event;
+            std::memcpy(&event, buffer_.data() + offset, sizeof(event));
+            // the name is null-padded
+            const char* name = buffer_.data() + offset + sizeof(event);
+            HandleEvent(event, event.len > 0 ? std::string_view{name} : std::string_view{});
+            offset += sizeof(event) + event.len;
+        }
+        Read();
+    }
+
+    void HandleEvent(const inotify_event& event, std::string_view name) {
+        if (event.mask & IN_Q_OVERFLOW) {
+            // events were lost
+            AddWatch(cache_.root_);
+            cache_.Load();
+            return;
+        }
+        if (event.mask & IN_IGNORED) {
+            directories_.erase(event.wd);
+            return;
+        }
+
+        auto it = directories_.find(event.wd);
+        if (it == directories_.end() || name.empty()) {
+            return;
+        }
+        const fs::path path = it->second / name;
+
+        if (event.mask & (IN_DELETE | IN_MOVED_FROM)) {
+            cache_.Remove(path);
+        }
+        else if (event.mask & IN_ISDIR) {
+            if (event.mask & (IN_CREATE | IN_MOVED_TO)) {
+                AddWatch(path);
+                cache_.AddDirectory(path);
+            }
+        }
+        else if (event.mask & IN_MODIFY) {
+            // the file is being written, it is served from disk until it is closed
+            cache_.Remove(path);
+        }
+        else {
+            cache_.Refresh(path);
+        }
+    }
+
+    net::io_context ioc_;
+    net::posix::stream_descriptor stream_;
+    StaticFileCache& cache_;
+    std::unordered_map<int, fs::path> directories_;
+    alignas(inotify_event) std::array<char, 64 * 1024> buffer_;
+    std::thread thread_;
+};
+
+#else
+
+class StaticFileCache::Watcher {
+public:
+    void Start() {
+    }
+};
+
+#endif
+
+StaticFileCache::StaticFileCache(fs::path root)
+    : root_{std::move(root)} {
+}
+
+StaticFileCache::~StaticFileCache() {
+    // the watcher thread works with the maps and the mutex, so it is stopped before they go away
+    watcher_.reset();
+}
+
+void StaticFileCache::Load() {
+    Clear();
+    AddDirectory(root_);
+    if (watcher_) {
+        watcher_->Start();
+    }
+}
+
+bool StaticFileCache::Watch() {
+#ifdef __linux__
+    const int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+
+    watcher_ = std::make_unique<Watcher>(*this, fd);
+    if (!watcher_->AddWatch(root_)) {
+        watcher_.reset();
+        return false;
+    }
+
+    watching_ = true;
+    return true;
+#else
+    return false;
+#endif
+}
+
+StaticFileCache::FilePtr StaticFileCache::Find(const fs::path& relative) {
+    fs::path normal = relative.lexically_normal();
+    if (!normal.empty() && !normal.has_filename()) {
+        // "dir/"
+        normal = normal.parent_path();
+    }
+    if (normal.is_absolute() || (!normal.empty() && *normal.begin() == "..")) {
+        return nullptr;
+    }
+
+    std::string key = normal.generic_string();
+    FilePtr file;
+    {
+        std::shared_lock lock{mutex_};
+        if (key.empty() || key == "." || directories_.contains(key)) {
+            key = "index.html";
+        }
+        auto it = files_.find(key);
+        if (it == files_.end()) {
+            return nullptr;
+        }
+        file = it->second;
+    }
+
+    if (watching_) {
+        return file;
+    }
+
+    // without notifications the file is checked on every lookup and reread on the calling thread,
+    // which is a network thread, so the copies are compressed fast rather than small
+    const fs::path path = root_ / key;
+    std::error_code ec;
+    const auto size = fs::file_size(path, ec);
+    if (!ec && size == file->bodies[static_cast<size_t>(ContentEncoding::Identity)]->size()) {
+        const auto write_time = fs::last_write_time(path, ec);
+        if (!ec && write_time == file->write_time) {
+            return file;
+        }
+    }
+    return Refresh(path, CompressionLevel::Fast);
+}
+
+std::string StaticFileCache::MakeKey(const fs::path& path) const {
+    std::string key = path.lexically_relative(root_).generic_string();
+    return key == "." ? std::string{} : key;
+}
+
+StaticFileCache::FilePtr StaticFileCache::Refresh(const fs::path& path, CompressionLevel level) {
+    std::error_code ec;
+    // a link is followed only inside the root
+    const bool is_link = fs::is_symlink(fs::symlink_status(path, ec));
+    const auto size = fs::file_size(path, ec);
+    const auto write_time = fs::last_write_time(path, ec);
+    if (ec || !fs::is_regular_file(path, ec) || size > kMaxFileSize || (is_link && !IsSubPath(path, root_))) {
+        Remove(path);
+        return nullptr;
+    }
+
+    std::optional<std::string> content = ReadFile(path);
+    if (!content) {
+        Remove(path);
+        return nullptr;
+    }
+
+    auto file = std::make_shared<File>();
+    file->etags = MakeEncodedETags(MakeStrongETag(*content));
+    file->compressible = IsCompressibleFile(path);
+    auto body = std::make_shared<const std::string>(std::move(*content));
+    if (file->compressible) {
+        file->bodies = CompressAll(std::move(body), level);
+    }
+    else {
+        file->bodies[static_cast<size_t>(ContentEncoding::Identity)] = std::move(body);
+    }
+    file->write_time = write_time;
+    file->modified = std::chrono::floor<std::chrono::seconds>(std::chrono::file_clock::to_sys(write_time));
+    file->last_modified = FormatHttpDate(file->modified);
+    file->content_type = DetectMime(path);
+
+    const std::string key = MakeKey(path);
+    const std::uintmax_t file_size = BodiesSize(file->bodies);
+
+    std::unique_lock lock{mutex_};
+    if (auto it = files_.find(key); it != files_.end()) {
+        total_size_ -= BodiesSize(it->second->bodies);
+        files_.erase(it);
+    }
+    if (total_size_ + file_size > kMaxTotalSize) {
+        return nullptr;
+    }
+    total_size_ += file_size;
+    return files_[key] = std::move(file);
+}
+
+void StaticFileCache::AddDirectory(const fs::path& path) {
+    if (std::string key = MakeKey(path); !key.empty()) {
+        std::unique_lock lock{mutex_};
+        directories_.insert(std::move(key));
+    }
+
+    std::error_code ec;
+    for (fs::recursive_directory_iterator it{path, ec}, end; !ec && it != end; it.increment(ec)) {
+        // linked directories are resolved on disk like any path outside the cache
+        if (it->is_symlink(ec) && it->is_directory(ec)) {
+            continue;
+        }
+        if (it->is_directory(ec)) {
+            std::unique_lock lock{mutex_};
+            directories_.insert(MakeKey(it->path()));
+        }
+        else if (it->is_regular_file(ec)) {
+            Refresh(it->path());
+        }
+    }
+}
+
+void StaticFileCache::Remove(const fs::path& path) {
+    const std::string key = MakeKey(path);
+
+    std::unique_lock lock{mutex_};
+    if (auto it = files_.find(key); it != files_.end()) {
+        total_size_ -= BodiesSize(it->second->bodies);
+        files_.erase(it);
+    }
+    if (directories_.erase(key) == 0) {
+        return;
+    }
+
+    const std::string prefix = key + "/";
+    std::erase_if(files_, [this, &prefix](const auto& entry) {
+        if (!entry.first.starts_with(prefix)) {
+            return false;
+        }
+        total_size_ -= BodiesSize(entry.second->bodies);
+        return true;
+    });
+    std::erase_if(directories_, [&prefix](const std::string& directory) {
+        return directory.starts_with(prefix);
+    });
+}
+
+void StaticFileCache::Clear() {
+    std::unique_lock lock{mutex_};
+    files_.clear();
+    directories_.clear();
+    total_size_ = 0;
+}
+
+} // namespace http_handler
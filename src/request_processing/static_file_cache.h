@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "compression.h"
+
+namespace http_handler {
+
+// content type of a static file by its extension
+std::string_view DetectMime(const std::filesystem::path& path);
+
+// text formats shrink well, images and audio are compressed already
+bool IsCompressibleFile(const std::filesystem::path& path);
+
+// static files kept in memory with their compressed copies and validators,
+// keyed by the path relative to the root, e.g. "js/game.js"
+// the cache is filled at startup; with Watch() changes of the root are picked up via inotify
+// on a thread of the watcher, so rereading and compressing never holds up the network threads;
+// otherwise a file is checked for size and modification time on every lookup
+class StaticFileCache {
+public:
+    // larger files, and files beyond the total budget, are served from disk
+    static constexpr std::uintmax_t kMaxFileSize = 8 * 1024 * 1024;
+    static constexpr std::uintmax_t kMaxTotalSize = 256 * 1024 * 1024;
+
+    struct File {
+        // Identity is always set, compressed variants only if they paid off
+        EncodedBodies bodies;
+        EncodedETags etags;
+        std::chrono::sys_seconds modified;
+        std::string last_modified;
+        std::string_view content_type;
+        bool compressible = false;
+
+        std::filesystem::file_time_type write_time;
+    };
+    using FilePtr = std::shared_ptr<const File>;
+
+    // root must be canonical
+    explicit StaticFileCache(std::filesystem::path root);
+    ~StaticFileCache();
+
+    StaticFileCache(const StaticFileCache&) = delete;
+    StaticFileCache& operator=(const StaticFileCache&) = delete;
+
+    // reads every file under the root, then starts handling the changes seen by Watch()
+    void Load();
+
+    // watches the root for changes from now on, returns false if inotify is not available
+    bool Watch();
+
+    // file for the normalized relative path, a directory resolves to the root index.html;
+    // nullptr if the path is not cached and has to be served from disk
+    FilePtr Find(const std::filesystem::path& relative);
+
+private:
+    class Watcher;
+
+    std::string MakeKey(const std::filesystem::path& path) const;
+    // (re)reads the file, drops it if it is gone or cannot be cached
+    FilePtr Refresh(const std::filesystem::path& path, CompressionLevel level = CompressionLevel::Best);
+    void AddDirectory(const std::filesystem::path& path);
+    // drops the file or the directory with everything below it
+    void Remove(const std::filesystem::path& path);
+    void Clear();
+
+    const std::filesystem::path root_;
+    std::unique_ptr<Watcher> watcher_;
+    std::atomic<bool> watching_ = false;
+
+    mutable std::shared_mutex mutex_;
+    std::unordered_map<std::string, FilePtr> files_;
+    std::unordered_set<std::string> directories_;
+    std::uintmax_t total_size_ = 0;
+};
+
+} // namespace http_handler
@@ -1,6 +1,15 @@
 #include "http_server.h"
 
 #include <boost/asio/dispatch.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#ifdef __linux__
+#include <sys/sendfile.h>
+#include <cerrno>
+#endif
+
+#include <algorithm>
 #include <iostream>
 
 namespace http_server {
@@ -18,6 +27,116 @@ void SessionBase::Run() {
                     beast::bind_front_handler(&SessionBase::Read, GetSharedThis()));
 }
 
+#ifdef __linux__
+
+struct SessionBase::FileTransfer {
+    // a connection that takes no data for this long is dropped
+    static constexpr auto kStallTimeout = 30s;
+    // after every chunk the next one is posted, so other sessions on the thread are not starved
+    // by a fast reader of a large file
+    static constexpr std::uint64_t kMaxChunk = 1024 * 1024;
+
+    FileTransfer(http::response<http::file_body>&& res, const net::any_io_executor& executor)
+        : response{std::move(res)}
+        , serializer{response}
+        , timer{executor} {
+    }
+
+    http::response<http::file_body> response;
+    http::response_serializer<http::file_body> serializer;
+    net::steady_timer timer;
+    std::uint64_t offset = 0;
+};
+
+void SessionBase::Write(http::response<http::file_body>&& response) {
+    auto transfer = std::make_shared<FileTransfer>(std::move(response), stream_.get_executor());
+    transfer->serializer.split(true);
+
+    http::async_write_header(stream_, transfer->serializer,
+        [self = GetSharedThis(), transfer](beast::error_code ec, std::size_t) {
+            if (ec) {
+                return self->OnWrite(true, ec, 0);
+            }
+            self->SendFile(transfer);
+        });
+}
+
+void SessionBase::SendFile(std::shared_ptr<FileTransfer> transfer) {
+    auto& socket = stream_.socket();
+    const int file = transfer->response.body().file().native_handle();
+    const std::uint64_t size = transfer->response.body().size();
+
+    beast::error_code ec;
+    socket.native_non_blocking(true, ec);
+
+    while (!ec && transfer->offset < size) {
+        off_t offset = static_cast<off_t>(transfer->offset);
+        const auto chunk = static_cast<std::size_t>(std::min(size - transfer->offset, FileTransfer::kMaxChunk));
+        const ssize_t sent = ::sendfile(socket.native_handle(), file, &offset, chunk);
+
+        if (sent > 0) {
+            transfer->offset += static_cast<std::uint64_t>(sent);
+            if (transfer->offset < size) {
+                net::post(stream_.get_executor(), [self = GetSharedThis(), transfer]() mutable {
+                    self->SendFile(std::move(transfer));
+                });
+                return;
+            }
+            continue;
+        }
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            // the socket buffer is full, continue once the peer has read some of it
+            transfer->timer.expires_after(FileTransfer::kStallTimeout);
+            transfer->timer.async_wait([self = GetSharedThis()](beast::error_code ec) {
+                if (!ec) {
+                    beast::error_code ignored;
+                    self->stream_.socket().cancel(ignored);
+                }
+            });
+            socket.async_wait(tcp::socket::wait_write, [self = GetSharedThis(), transfer](beast::error_code ec) {
+                transfer->timer.cancel();
+                if (ec) {
+                    return self->OnFileSent(transfer, ec);
+                }
+                self->SendFile(std::move(transfer));
+            });
+            return;
+        }
+        if (sent < 0 && transfer->offset == 0 && (errno == EINVAL || errno == ENOSYS)) {
+            // the file system does not support sendfile, the body is written from user space
+            http::async_write(stream_, transfer->serializer, 
+                [self = GetSharedThis(), transfer](beast::error_code ec, std::size_t) {
+                    self->OnFileSent(transfer, ec);
+                });
+            return;
+        }
+
+        // the file was truncated while it was sent
+        ec = (sent == 0) ? beast::error_code{net::error::eof} : beast::error_code{errno, sys::system_category()};
+    }
+
+    OnFileSent(transfer, ec);
+}
+
+void SessionBase::OnFileSent(const std::shared_ptr<FileTransfer>& transfer, beast::error_code ec) {
+    if (!ec) {
+        LogResponse(transfer->response);
+    }
+    // the length promised in the header was not sent, so the connection cannot be reused after an error
+    OnWrite(ec || transfer->response.need_eof(), ec, transfer->offset);
+}
+
+#else
+
+void SessionBase::Write(http::response<http::file_body>&& response) {
+    Write<http::file_body, http::fields>(std::move(response));
+}
+
+#endif
+
 void SessionBase::OnWrite(bool close, beast::error_code ec, [[maybe_unused]] std::size_t bytes_written) {
     if (ec) {
         return ReportError(ec, "write"sv);
@@ -59,6 +178,11 @@ void SessionBase::OnRead(beast::error_code ec, [[maybe_unused]] std::size_t byte
     request_start_time_ = std::chrono::steady_clock::now();
     logger::LogRequest(ip, request_.target(), request_.method_string());   
 
+    if (websocket::is_upgrade(request_) && HandleUpgrade(request_, stream_)) {
+        // the stream now belongs to the websocket session
+        return;
+    }
+
     HandleRequest(std::move(request_));
 }
 
@@ -7,19 +7,39 @@
 #include <boost/asio/strand.hpp>
 #include <boost/beast/core.hpp>
 #include <boost/beast/http.hpp>
+#include <boost/beast/websocket.hpp>
 
 #include "../detail/logger.h"
 
+#include <array>
+#include <cstdint>
+#include <string>
+
 namespace http_server {
 
 namespace net = boost::asio;
 namespace beast = boost::beast;
 namespace http = beast::http;
+namespace websocket = beast::websocket;
 namespace sys = boost::system;
 using tcp = net::ip::tcp;
 
 void ReportError(beast::error_code ec, std::string_view what);
 
+// bearer credentials last accepted on a connection, kept by the session for the request handler:
+// clients send the same token with every request, so it is resolved once per connection;
+// a connection sends its next request only after the response, so the cache needs no locking
+struct AuthCache {
+    // 128-bit token
+    std::array<std::uint8_t, 16> token{};
+    // whom the token identifies and what it grants access to
+    std::uint64_t subject = 0;
+    std::string scope;
+    // the owner of the tokens changes its generation on revocation, older entries are stale
+    std::uint64_t generation = 0;
+    bool valid = false;
+};
+
 class SessionBase {
 public:
     // Запрещаем копирование и присваивание объектов SessionBase и его наследников
@@ -35,6 +55,10 @@ protected:
 
     ~SessionBase() = default;
 
+    AuthCache& GetAuthCache() {
+        return auth_cache_;
+    }
+
     template <typename Body, typename Fields>
     void Write(http::response<Body, Fields>&& response) {
         // Запись выполняется асинхронно, поэтому response перемещаем в область кучи
@@ -44,32 +68,39 @@ protected:
         http::async_write(stream_, *safe_response,
                         [safe_response, self](beast::error_code ec, std::size_t bytes_written) {
                             if (!ec) {
-                                using namespace std::chrono;
-                                auto now = steady_clock::now();
-                                auto duration = duration_cast<milliseconds>(now - self->request_start_time_).count();
-
-                                unsigned status = safe_response->result_int();
-                                auto it = safe_response->find(http::field::content_type);
-                                std::string_view content_type;
-                                if (it != safe_response->end()) {
-                                    content_type = it->value();
-                                } else {
-                                    content_type = {};
-                                }
-                                
-                                auto ip = self->stream_.socket().remote_endpoint().address().to_string();
-
-                                logger::LogResponse(ip, duration, status, content_type);
-                            }                           
+                                self->LogResponse(*safe_response);
+                            }
 
                             self->OnWrite(safe_response->need_eof(), ec, bytes_written);
                         });
     }
 
+    // on Linux the file is passed to the socket with sendfile after the header is written,
+    // so its content does not go through user space; elsewhere it is written like any body
+    void Write(http::response<http::file_body>&& response);
+
 public:
     void Run();
 
 private:
+    template <typename Body, typename Fields>
+    void LogResponse(const http::response<Body, Fields>& response) {
+        using namespace std::chrono;
+        auto duration = duration_cast<milliseconds>(steady_clock::now() - request_start_time_).count();
+
+        auto it = response.find(http::field::content_type);
+        std::string_view content_type = (it != response.end()) ? it->value() : std::string_view{};
+
+        beast::error_code ec;
+        auto ip = stream_.socket().remote_endpoint(ec).address().to_string();
+
+        logger::LogResponse(ip, duration, response.result_int(), content_type);
+    }
+
+    struct FileTransfer;
+    void SendFile(std::shared_ptr<FileTransfer> transfer);
+    void OnFileSent(const std::shared_ptr<FileTransfer>& transfer, beast::error_code ec);
+
     void OnWrite(bool close, beast::error_code ec, [[maybe_unused]] std::size_t bytes_written);
     void Read();
     void OnRead(beast::error_code ec, [[maybe_unused]] std::size_t bytes_read);
@@ -77,6 +108,9 @@ private:
 
     // Обработку запроса делегируем подклассу
     virtual void HandleRequest(HttpRequest&& request) = 0;
+    // websocket upgrade: returns true if the stream was taken over,
+    // otherwise the request is handled as a plain HTTP one
+    virtual bool HandleUpgrade(HttpRequest& request, beast::tcp_stream& stream) = 0;
     virtual std::shared_ptr<SessionBase> GetSharedThis() = 0;
 
 private:
@@ -84,17 +118,19 @@ private:
     beast::tcp_stream stream_;
     beast::flat_buffer buffer_;
     HttpRequest request_;
+    AuthCache auth_cache_;
 
     std::chrono::steady_clock::time_point request_start_time_;
 };
 
-template <typename RequestHandler>
-class Session : public SessionBase, public std::enable_shared_from_this<Session<RequestHandler>> {
+template <typename RequestHandler, typename UpgradeHandler>
+class Session : public SessionBase, public std::enable_shared_from_this<Session<RequestHandler, UpgradeHandler>> {
 public:
-    template <typename Handler>
-    Session(tcp::socket&& socket, Handler&& request_handler)
+    template <typename Handler, typename Upgrade>
+    Session(tcp::socket&& socket, Handler&& request_handler, Upgrade&& upgrade_handler)
         : SessionBase(std::move(socket))
-        , request_handler_(std::forward<Handler>(request_handler)) {
+        , request_handler_(std::forward<Handler>(request_handler))
+        , upgrade_handler_(std::forward<Upgrade>(upgrade_handler)) {
     }
 
 private:
@@ -102,28 +138,34 @@ private:
         // Захватываем умный указатель на текущий объект Session в лямбде,
         // чтобы продлить время жизни сессии до вызова лямбды.
         // Используется generic-лямбда функция, способная принять response произвольного типа
-        request_handler_(std::move(request), [self = this->shared_from_this()](auto&& response) {
+        request_handler_(std::move(request), GetAuthCache(), [self = this->shared_from_this()](auto&& response) {
             self->Write(std::move(response));
         });
     }
 
+    bool HandleUpgrade(HttpRequest& request, beast::tcp_stream& stream) override {
+        return upgrade_handler_(request, stream);
+    }
+
     std::shared_ptr<SessionBase> GetSharedThis() override {
         return this->shared_from_this();
     }
 
 private:
     RequestHandler request_handler_;
+    UpgradeHandler upgrade_handler_;
 };
 
-template <typename RequestHandler>
-class Listener : public std::enable_shared_from_this<Listener<RequestHandler>> {
+template <typename RequestHandler, typename UpgradeHandler>
+class Listener : public std::enable_shared_from_this<Listener<RequestHandler, UpgradeHandler>> {
 public:
-    template <typename Handler>
-    Listener(net::io_context& ioc, const tcp::endpoint& endpoint, Handler&& request_handler)
+    template <typename Handler, typename Upgrade>
+    Listener(net::io_context& ioc, const tcp::endpoint& endpoint, Handler&& request_handler, Upgrade&& upgrade_handler)
         : ioc_(ioc)
         // Обработчики асинхронных операций acceptor_ будут вызываться в своём strand
         , acceptor_(net::make_strand(ioc))
-        , request_handler_(std::forward<Handler>(request_handler)) {
+        , request_handler_(std::forward<Handler>(request_handler))
+        , upgrade_handler_(std::forward<Upgrade>(upgrade_handler)) {
         // Открываем acceptor, используя протокол (IPv4 или IPv6), указанный в endpoint
         acceptor_.open(endpoint.protocol());
 
@@ -145,7 +187,8 @@ public:
 
 private:
     void AsyncRunSession(tcp::socket&& socket) {
-        std::make_shared<Session<RequestHandler>>(std::move(socket), request_handler_)->Run();
+        std::make_shared<Session<RequestHandler, UpgradeHandler>>(std::move(socket), request_handler_, 
+                                                                  upgrade_handler_)->Run();
     }
 
     void DoAccept() {
@@ -183,15 +226,22 @@ private:
     net::io_context& ioc_;
     tcp::acceptor acceptor_;
     RequestHandler request_handler_;
+    UpgradeHandler upgrade_handler_;
 };
 
-template <typename RequestHandler>
-void ServeHttp(net::io_context& ioc, const tcp::endpoint& endpoint, RequestHandler&& handler) {
+// handler is called as void(HttpRequest&& request, AuthCache& auth, Send&& send),
+// the cache belongs to the connection and stays alive while send is held;
+// upgrade_handler is called as bool(HttpRequest& request, beast::tcp_stream& stream)
+// for websocket upgrade requests, see SessionBase::HandleUpgrade
+template <typename RequestHandler, typename UpgradeHandler>
+void ServeHttp(net::io_context& ioc, const tcp::endpoint& endpoint, RequestHandler&& handler, 
+               UpgradeHandler&& upgrade_handler) {
     // При помощи decay_t исключим ссылки из типа RequestHandler,
     // чтобы Listener хранил RequestHandler по значению
-    using MyListener = Listener<std::decay_t<RequestHandler>>;
+    using MyListener = Listener<std::decay_t<RequestHandler>, std::decay_t<UpgradeHandler>>;
 
-    std::make_shared<MyListener>(ioc, endpoint, std::forward<RequestHandler>(handler))->Run();
+    std::make_shared<MyListener>(ioc, endpoint, std::forward<RequestHandler>(handler), 
+                                 std::forward<UpgradeHandler>(upgrade_handler))->Run();
 }
 
 }  // namespace http_server
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <unordered_map>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/strand.hpp>
+
+#include "../game_model/model.h"
+
+namespace server {
+
+namespace net = boost::asio;
+
+// every map gets its own strand, so requests and ticks of different maps run in parallel
+// the common strand serializes work that is not bound to a single map
+class MapStrands {
+public:
+    using Strand = net::strand<net::io_context::executor_type>;
+
+    MapStrands(net::io_context& ioc, const model::Game::Maps& maps)
+        : common_strand_{net::make_strand(ioc)} {
+        strands_.reserve(maps.size());
+        for (const auto& map : maps) {
+            strands_.emplace(map.GetId(), net::make_strand(ioc));
+        }
+    }
+
+    MapStrands(const MapStrands&) = delete;
+    MapStrands& operator=(const MapStrands&) = delete;
+
+    Strand GetCommonStrand() const {
+        return common_strand_;
+    }
+
+    // unknown maps are served by the common strand
+    Strand GetStrandForMap(const model::Map::Id& id) const {
+        if (auto it = strands_.find(id); it != strands_.end()) {
+            return it->second;
+        }
+        return common_strand_;
+    }
+
+    size_t GetMapCount() const {
+        return strands_.size();
+    }
+
+    template <typename Fn>
+    void ForEachMap(Fn&& fn) const {
+        for (const auto& [id, strand] : strands_) {
+            fn(id, strand);
+        }
+    }
+
+private:
+    using MapIdHasher = util::TaggedHasher<model::Map::Id>;
+
+    Strand common_strand_;
+    std::unordered_map<model::Map::Id, Strand, MapIdHasher> strands_;
+};
+
+} // namespace server
@@ -0,0 +1,124 @@
+#include "websocket_session.h"
+
+#include <boost/asio/dispatch.hpp>
+#include <boost/asio/post.hpp>
+
+namespace http_server {
+
+using namespace std::literals;
+
+namespace {
+
+// commands are short json objects
+constexpr std::size_t kMaxMessageSize = 4096;
+
+}  // namespace
+
+WebSocketSession::WebSocketSession(beast::tcp_stream&& stream, MessageHandler handler)
+    : ws_(std::move(stream))
+    , handler_(std::move(handler)) {
+}
+
+void WebSocketSession::Run(HttpRequest&& request) {
+    // the websocket stream has its own ping based timeouts
+    beast::get_lowest_layer(ws_).expires_never();
+    ws_.set_option(websocket::stream_base::timeout::suggested(beast::role_type::server));
+    ws_.read_message_max(kMaxMessageSize);
+    ws_.text(true);
+
+    auto safe_request = std::make_shared<HttpRequest>(std::move(request));
+    net::dispatch(ws_.get_executor(), [self = shared_from_this(), safe_request] {
+        self->ws_.async_accept(*safe_request, [self, safe_request](beast::error_code ec) {
+            self->OnAccept(ec);
+        });
+    });
+}
+
+void WebSocketSession::Push(Frame frame) {
+    net::post(ws_.get_executor(), [self = shared_from_this(), frame = std::move(frame)]() mutable {
+        if (!self->open_) {
+            return;
+        }
+        self->pending_ = std::move(frame);
+        if (!self->writing_) {
+            self->Write();
+        }
+    });
+}
+
+void WebSocketSession::Close(websocket::close_reason reason) {
+    net::post(ws_.get_executor(), [self = shared_from_this(), reason = std::move(reason)]() mutable {
+        if (!self->open_) {
+            return;
+        }
+        // nothing is pushed after the close frame
+        self->open_ = false;
+        self->pending_.reset();
+        self->close_reason_ = std::move(reason);
+        if (!self->writing_) {
+            self->DoClose();
+        }
+    });
+}
+
+void WebSocketSession::DoClose() {
+    // the pending read completes with websocket::error::closed once the client answers
+    ws_.async_close(*close_reason_, [self = shared_from_this()](beast::error_code ec) {
+        if (ec) {
+            ReportError(ec, "websocket close"sv);
+        }
+    });
+}
+
+void WebSocketSession::OnAccept(beast::error_code ec) {
+    if (ec) {
+        return ReportError(ec, "websocket accept"sv);
+    }
+
+    open_ = true;
+    Read();
+}
+
+void WebSocketSession::Read() {
+    buffer_.clear();
+    ws_.async_read(buffer_, beast::bind_front_handler(&WebSocketSession::OnRead, shared_from_this()));
+}
+
+void WebSocketSession::OnRead(beast::error_code ec, [[maybe_unused]] std::size_t bytes_read) {
+    if (ec) {
+        open_ = false;
+        pending_.reset();
+        if (ec != websocket::error::closed) {
+            ReportError(ec, "websocket read"sv);
+        }
+        return;
+    }
+
+    handler_(beast::buffers_to_string(buffer_.data()));
+    Read();
+}
+
+void WebSocketSession::Write() {
+    writing_ = std::move(pending_);
+    pending_.reset();
+    ws_.async_write(net::buffer(*writing_),
+                    beast::bind_front_handler(&WebSocketSession::OnWrite, shared_from_this()));
+}
+
+void WebSocketSession::OnWrite(beast::error_code ec, [[maybe_unused]] std::size_t bytes_written) {
+    writing_.reset();
+    if (ec) {
+        open_ = false;
+        pending_.reset();
+        return ReportError(ec, "websocket write"sv);
+    }
+
+    if (close_reason_) {
+        DoClose();
+    }
+    else if (open_ && pending_) {
+        Write();
+    }
+}
+
+}  // namespace http_server
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "http_server.h"
+
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+
+namespace http_server {
+
+// websocket connection taken over from an HTTP session
+// incoming text messages are passed to the handler, outgoing frames are shared immutable
+// strings; while a frame is being written only the latest pushed frame waits for its turn,
+// so a slow client skips intermediate frames instead of growing a queue
+class WebSocketSession : public std::enable_shared_from_this<WebSocketSession> {
+public:
+    using HttpRequest = http::request<http::string_body>;
+    using Frame = std::shared_ptr<const std::string>;
+    using MessageHandler = std::function<void(std::string&& message)>;
+
+    WebSocketSession(beast::tcp_stream&& stream, MessageHandler handler);
+
+    WebSocketSession(const WebSocketSession&) = delete;
+    WebSocketSession& operator=(const WebSocketSession&) = delete;
+
+    // accepts the upgrade request and starts reading messages
+    void Run(HttpRequest&& request);
+
+    // may be called from any thread
+    void Push(Frame frame);
+    // sends a close frame with the reason once the current write is done, may be called from any thread
+    void Close(websocket::close_reason reason);
+
+private:
+    void OnAccept(beast::error_code ec);
+    void Read();
+    void OnRead(beast::error_code ec, [[maybe_unused]] std::size_t bytes_read);
+    void Write();
+    void OnWrite(beast::error_code ec, [[maybe_unused]] std::size_t bytes_written);
+    void DoClose();
+
+private:
+    websocket::stream<beast::tcp_stream> ws_;
+    beast::flat_buffer buffer_;
+    MessageHandler handler_;
+
+    // accessed on the executor of ws_ only
+    bool open_ = false;
+    Frame writing_;
+    Frame pending_;
+    std::optional<websocket::close_reason> close_reason_;
+};
+
+}  // namespace http_server